@@ -0,0 +1,787 @@
+#!/usr/bin/env python3
+"""
+Columnar campaign archive: injection events, server failures and
+per-variant summaries of many runs in one compressed file, queried without
+re-parsing dmesg or server logs.
+
+Tables:
+
+    inj      one row per injection (dmesg "fs_injector: inj_id=..." lines):
+             ts_ns symbol comm pid task call_idx old_ret new_ret errno
+             fault delay_us
+    fail     one row per server FAIL line: seq (line number) sc errno ret
+             detail
+    variant  one row per journaled errno variant (--journal), or one for
+             the whole server log when there is no journal: syscall errno
+             errno_num outcome exit injections fails cascade max_cascade
+             p50_us p99_us t_start secs (-1 = unknown)
+
+Every table also has the run's columns: run, kernel, host, mode.
+
+File layout: "FSARCH01", then appended segments of at most SEGMENT_ROWS
+rows of one table and one run. Each segment is a u32 length and a JSON
+header (table, rows, run, and per column: type, compressed length, min/max),
+followed by one zlib block per column. String columns are
+dictionary-encoded. Integer columns use the narrowest array type that fits
+the segment's values, and ts_ns is delta-encoded. A query reads only the
+headers and the blocks of the columns it uses. It skips whole segments
+whose run, dictionary or min/max cannot match.
+
+Scans stay in C: predicates on one-byte columns are bytes.translate tables,
+others are map() over builtin bound methods, masks are ANDed as big
+integers, and grouping is Counter(zip(compress(...))).
+
+    ./archive.py add campaigns.fsa --run=k6.8-openat --dmesg=dmesg.txt \\
+            --server-log=server_openat.log --journal=../journal_openat.jsonl
+    ./archive.py query campaigns.fsa --table=variant \\
+            --where=mode=openat,errno=EIO,cascade>=0 --by=kernel \\
+            --agg=count,mean:cascade,max:max_cascade
+
+Usage: ./archive.py add ARCHIVE [--run=NAME] [--kernel=REL] [--mode=NAME]
+         [--dmesg[=FILE]] [--server-log=FILE] [--journal=FILE]
+         [--outcome-cache=FILE] [--errno=NAME]
+       ./archive.py query ARCHIVE --table=inj|fail|variant [--where=EXPR,...]
+         [--by=COL[,COL]] [--agg=count,sum:COL,mean:COL,min:COL,max:COL,
+         pNN:COL] [--sort=AGG] [--limit=N]
+       ./archive.py info ARCHIVE
+"""
+import errno
+import fnmatch
+import json
+import math
+import os
+import re
+import socket
+import struct
+import subprocess
+import sys
+import time
+import zlib
+from array import array
+from bisect import bisect_left, bisect_right
+from collections import Counter, defaultdict
+from itertools import accumulate, compress
+
+from controller import find_int_opt, find_opt
+
+MAGIC = b"FSARCH01"
+SEG_LEN = struct.Struct("<I")
+SEGMENT_ROWS = 1 << 20
+RUN_COLUMNS = ("run", "kernel", "host", "mode")
+
+INJ_RE = re.compile(r"fs_injector: inj_id=\d+ pid=(\d+) comm=(.*?) "
+                    r"symbol=(\S+) old_ret=(-?\d+) new_ret=(-?\d+) "
+                    r"ts_ns=(-?\d+) unsafe=\d+ mode=(\d+) delay_us=(\d+) "
+                    r"task=(-?\d+) call_idx=(\d+)")
+FAIL_RE = re.compile(r"\[SERVER\] (\S+) FAIL ret=(-?\d+) errno=(\d+) "
+                     r"\(.*?\) detail=(.*)$")
+LATENCY_RE = re.compile(r"\[SERVER\] \S+ LATENCY scope=total n=\d+ "
+                        r"mean_us=[\d.]+ p50_us=([\d.]+) p90_us=[\d.]+ "
+                        r"p99_us=([\d.]+)")
+CASCADE_RE = re.compile(r"\[SERVER\] (\S+) CASCADE iters=\d+ "
+                        r"fail_iters=(\d+) fails=(\d+) max_cascade=(\d+)")
+WHERE_RE = re.compile(r"^(\w+)(!=|<=|>=|=|<|>)(.*)$")
+
+INT_TYPES = [("B", 0, 0xff), ("b", -0x80, 0x7f), ("H", 0, 0xffff),
+             ("h", -0x8000, 0x7fff), ("I", 0, 0xffffffff),
+             ("i", -0x80000000, 0x7fffffff), ("q", -(1 << 63), (1 << 63) - 1)]
+INVERT = bytes([1, 0]) + bytes(254)
+
+
+# ---- WRITING ----
+
+def int_type(lo, hi):
+    for code, tlo, thi in INT_TYPES:
+        if tlo <= lo and hi <= thi:
+            return code
+    raise ValueError(f"integer column out of range: {lo}..{hi}")
+
+
+def to_bytes(arr):
+    if sys.byteorder == "big":
+        arr = array(arr.typecode, arr)
+        arr.byteswap()
+    return arr.tobytes()
+
+
+def encode_column(name, kind, vals):
+    """
+    (header dict, compressed block) for one column of one segment. kind is
+    "str", "int", "delta" (int stored as differences) or "float".
+    """
+    col = {"name": name}
+    if kind == "str":
+        index = {}
+        codes = [index.setdefault(v, len(index)) for v in vals]
+        col["type"] = "str"
+        col["dict"] = list(index)
+        raw = to_bytes(array(int_type(0, max(len(index) - 1, 0)), codes))
+    elif kind == "float":
+        col.update(type="d", min=min(vals), max=max(vals))
+        raw = to_bytes(array("d", vals))
+    else:
+        col.update(min=min(vals), max=max(vals))
+        if kind == "delta":
+            vals = [vals[0]] + [b - a for a, b in zip(vals, vals[1:])]
+            col["delta"] = True
+        col["type"] = int_type(min(vals), max(vals))
+        raw = to_bytes(array(col["type"], vals))
+    block = zlib.compress(raw, 6)
+    col["len"] = len(block)
+    return col, block
+
+
+def append_table(path, table, run, columns):
+    """
+    Append rows to ARCHIVE. columns is a list of (name, kind, values), all
+    of the same length; rows are split into segments of SEGMENT_ROWS.
+    """
+    nrows = len(columns[0][2]) if columns else 0
+    new = not os.path.exists(path)
+    with open(path, "ab") as f:
+        if new:
+            f.write(MAGIC)
+        for lo in range(0, nrows, SEGMENT_ROWS):
+            hi = min(nrows, lo + SEGMENT_ROWS)
+            heads, blocks = [], []
+            for name, kind, vals in columns:
+                col, block = encode_column(name, kind, vals[lo:hi])
+                heads.append(col)
+                blocks.append(block)
+            meta = json.dumps({"table": table, "rows": hi - lo, "run": run,
+                               "cols": heads},
+                              separators=(",", ":")).encode()
+            f.write(SEG_LEN.pack(len(meta)) + meta)
+            for block in blocks:
+                f.write(block)
+        f.flush()
+        os.fsync(f.fileno())
+    return nrows
+
+
+# ---- READING ----
+
+class Segment:
+    """
+    One segment: header parsed, column blocks decompressed on first use.
+    """
+
+    def __init__(self, f, meta, offset):
+        self.f = f
+        self.table = meta["table"]
+        self.rows = meta["rows"]
+        self.run = meta["run"]
+        self.cols = {}
+        for col in meta["cols"]:
+            col["off"] = offset
+            offset += col["len"]
+            self.cols[col["name"]] = col
+        self.end = offset
+        self.cache = {}
+
+    def raw(self, name):
+        """
+        Decompressed bytes of a column (the codes for a string column).
+        """
+        if name not in self.cache:
+            col = self.cols[name]
+            self.f.seek(col["off"])
+            self.cache[name] = zlib.decompress(self.f.read(col["len"]))
+        return self.cache[name]
+
+    def values(self, name):
+        """
+        A sequence of the column's values (codes for a string column).
+        """
+        col = self.cols[name]
+        code = col["type"]
+        if code == "str":
+            code = int_type(0, max(len(col["dict"]) - 1, 0))
+        if code == "B" and not col.get("delta"):
+            return self.raw(name)
+        key = name + ":v"
+        if key not in self.cache:
+            arr = array(code)
+            arr.frombytes(self.raw(name))
+            if sys.byteorder == "big":
+                arr.byteswap()
+            if col.get("delta"):
+                arr = array("q", accumulate(arr))
+            self.cache[key] = arr
+        return self.cache[key]
+
+    def narrow(self, name):
+        """
+        True when the column's values or codes are one byte each.
+        """
+        col = self.cols[name]
+        if col["type"] == "str":
+            return len(col["dict"]) <= 256
+        return col["type"] == "B" and not col.get("delta")
+
+
+def open_archive(path):
+    """
+    (file, [Segment]) for ARCHIVE; only the segment headers are read.
+    """
+    f = open(path, "rb")
+    if f.read(len(MAGIC)) != MAGIC:
+        raise ValueError(f"{path}: not a campaign archive")
+    segs = []
+    size = os.fstat(f.fileno()).st_size
+    pos = len(MAGIC)
+    while pos + SEG_LEN.size <= size:
+        f.seek(pos)
+        (n,) = SEG_LEN.unpack(f.read(SEG_LEN.size))
+        try:
+            meta = json.loads(f.read(n))
+        except ValueError:
+            break
+        seg = Segment(f, meta, pos + SEG_LEN.size + n)
+        if seg.end > size:
+            break
+        # a torn append (crash mid-write) leaves a partial last segment
+        segs.append(seg)
+        pos = seg.end
+    return f, segs
+
+
+# ---- MASKS ----
+# A mask is None (every row), False (no row) or bytes of 0/1 per row.
+# Wide integer columns are compared one byte plane at a time (v[k::width]
+# through a 256-entry table); the per-plane results combine as big ints.
+
+EQ = [bytes(int(b == v) for b in range(256)) for v in range(256)]
+LT = [bytes(int(b < v) for b in range(256)) for v in range(256)]
+FLIP = bytes(b ^ 0x80 for b in range(256))
+
+
+def to_mask(m, n):
+    return m.to_bytes(n, "little") if m else False
+
+
+def bits(m):
+    return int.from_bytes(m, "little")
+
+
+def and_mask(a, b, n):
+    if a is None:
+        return b
+    if b is None:
+        return a
+    if a is False or b is False:
+        return False
+    return to_mask(bits(a) & bits(b), n)
+
+
+def invert_mask(m):
+    if m is None:
+        return False
+    if m is False:
+        return None
+    return m.translate(INVERT)
+
+
+def planes(src, name):
+    """
+    (byte planes, bias) of an integer column: planes[k] holds byte k of
+    every value, and values + bias compare as unsigned.
+    """
+    key = name + ":p"
+    if key not in src.cache:
+        vals = src.values(name)
+        if isinstance(vals, bytes):
+            src.cache[key] = ([vals], 0)
+        else:
+            raw, w = to_bytes(vals), vals.itemsize
+            ps = [raw[k::w] for k in range(w)]
+            bias = 0
+            if vals.typecode in "bhilq":
+                ps[-1] = ps[-1].translate(FLIP)
+                bias = 1 << (8 * w - 1)
+            src.cache[key] = (ps, bias)
+    return src.cache[key]
+
+
+def planes_eq(ps, c):
+    if c < 0 or c >> (8 * len(ps)):
+        return 0
+    m = -1
+    for k, p in enumerate(ps):
+        m &= bits(p.translate(EQ[(c >> (8 * k)) & 0xff]))
+        if not m:
+            break
+    return m
+
+
+def planes_lt(ps, c, ones):
+    if c <= 0:
+        return 0
+    if c >> (8 * len(ps)):
+        return ones
+    m = 0
+    for k, p in enumerate(ps):
+        ck = (c >> (8 * k)) & 0xff
+        lt = bits(p.translate(LT[ck]))
+        m = lt | (bits(p.translate(EQ[ck])) & m) if m else lt
+    return m
+
+
+def value_mask(src, name, want):
+    """
+    Mask of the rows whose value (or code) is one of want.
+    """
+    want = [w for w in want if w == int(w)]
+    if src.narrow(name):
+        table = bytearray(256)
+        for w in want:
+            if 0 <= w <= 255:
+                table[int(w)] = 1
+        return src.values(name).translate(bytes(table))
+    ps, bias = planes(src, name)
+    m = 0
+    for w in want:
+        m |= planes_eq(ps, int(w) + bias)
+    return to_mask(m, src.rows)
+
+
+def code_mask(src, name, hits, ncodes):
+    if not hits:
+        return False
+    if len(hits) == ncodes:
+        return None
+    return value_mask(src, name, hits)
+
+
+def parse_value(text):
+    try:
+        return int(text)
+    except ValueError:
+        pass
+    try:
+        return float(text)
+    except ValueError:
+        pass
+    if hasattr(errno, text):
+        return getattr(errno, text)     # errno>=... takes names
+    raise ValueError(f"not a number: {text}")
+
+
+def compare(op, rhs):
+    """
+    A C-level callable v -> bool for an ordering operator.
+    """
+    return {"<": rhs.__gt__, "<=": rhs.__ge__,
+            ">": rhs.__lt__, ">=": rhs.__le__}[op]
+
+
+def cond_mask(seg, name, op, text):
+    """
+    Mask of one --where condition in one segment. Run columns and the
+    column dictionary / min-max decide most segments without a scan.
+    """
+    if op == "!=":
+        return invert_mask(cond_mask(seg, name, "=", text))
+    alts = text.split("|")
+
+    if name in RUN_COLUMNS:
+        v = str(seg.run.get(name, ""))
+        if op == "=":
+            return None if any(fnmatch.fnmatchcase(v, a) for a in alts) \
+                else False
+        return None if compare(op, alts[0])(v) else False
+
+    col = seg.cols[name]
+    if col["type"] == "str":
+        words = col["dict"]
+        if op == "=":
+            hits = [i for i, w in enumerate(words)
+                    if any(fnmatch.fnmatchcase(w, a) for a in alts)]
+        else:
+            hits = [i for i, w in enumerate(words) if compare(op, alts[0])(w)]
+        return code_mask(seg, name, hits, len(words))
+
+    lo, hi = col["min"], col["max"]
+    if op == "=":
+        want = [parse_value(a) for a in alts]
+        if not any(lo <= w <= hi for w in want):
+            return False
+        if lo == hi:
+            return None
+        if col["type"] == "d":
+            return bytes(map(set(want).__contains__, seg.values(name)))
+        return value_mask(seg, name, want)
+
+    rhs = parse_value(alts[0])
+    # int.__gt__(float) is NotImplemented, which is truthy
+    pred = compare(op, float(rhs) if col["type"] == "d" else rhs)
+    if pred(lo) and pred(hi):
+        return None
+    if not pred(lo) and not pred(hi):
+        return False
+    if col["type"] == "d":
+        return bytes(map(pred, seg.values(name)))
+
+    # v < c and v >= c for an integer c
+    c = math.ceil(rhs) if op in ("<", ">=") else math.floor(rhs) + 1
+    ps, bias = planes(seg, name)
+    ones = bits(b"\x01" * seg.rows)
+    m = planes_lt(ps, c + bias, ones)
+    return to_mask(m if op in ("<", "<=") else ones ^ m, seg.rows)
+
+
+def parse_where(text):
+    conds = []
+    for part in (text or "").split(","):
+        if not part:
+            continue
+        m = WHERE_RE.match(part)
+        if not m:
+            raise ValueError(f"bad --where condition '{part}'")
+        conds.append(m.groups())
+    return conds
+
+
+# ---- QUERY ----
+
+class View:
+    """
+    The rows of a segment that passed --where, each column materialised
+    once, so grouping only walks the selected rows.
+    """
+
+    def __init__(self, seg, mask):
+        self.seg = seg
+        self.mask = mask
+        self.cols = seg.cols
+        self.run = seg.run
+        self.rows = seg.rows if mask is None else mask.count(1)
+        self.cache = {}
+
+    def narrow(self, name):
+        return self.seg.narrow(name)
+
+    def values(self, name):
+        if self.mask is None:
+            return self.seg.values(name)
+        if name not in self.cache:
+            vals = self.seg.values(name)
+            sel = compress(vals, self.mask)
+            self.cache[name] = bytes(sel) if isinstance(vals, bytes) \
+                else array(vals.typecode, sel)
+        return self.cache[name]
+
+
+class Agg:
+    """
+    Per-group accumulator: row count and, per value column, the values.
+    """
+
+    def __init__(self):
+        self.count = 0
+        self.vals = {}
+
+    def add(self, name, code, it):
+        arr = self.vals.setdefault(name, array(code))
+        if not (isinstance(it, array) and it.typecode == code):
+            it = iter(it)
+        arr.extend(it)
+
+    def result(self, spec):
+        if spec == "count":
+            return self.count
+        fn, col = spec.split(":", 1)
+        vals = self.vals.get(col)
+        if not vals:
+            return None
+        if fn == "sum":
+            return sum(vals)
+        if fn == "mean":
+            return sum(vals) / len(vals)
+        if fn == "min":
+            return min(vals)
+        if fn == "max":
+            return max(vals)
+        s = sorted(vals)
+        return s[min(len(s) - 1, int(float(fn[1:]) / 100.0 * len(s)))]
+
+
+def label(seg, name, v):
+    col = seg.cols[name]
+    return col["dict"][v] if col["type"] == "str" else v
+
+
+def run_query(path, table, conds, keys, aggs):
+    value_cols = sorted({a.split(":", 1)[1] for a in aggs if a != "count"})
+    groups = {}
+    f, segs = open_archive(path)
+    scanned = rows = 0
+    try:
+        for seg in segs:
+            if seg.table != table:
+                continue
+            for name in [c[0] for c in conds] + keys + value_cols:
+                if name not in seg.cols and name not in RUN_COLUMNS:
+                    raise ValueError(f"table '{table}' has no column "
+                                     f"'{name}' (columns: "
+                                     f"{', '.join(list(seg.cols) + list(RUN_COLUMNS))})")
+            mask = None
+            for name, op, text in conds:
+                mask = and_mask(mask, cond_mask(seg, name, op, text),
+                                seg.rows)
+                if mask is False:
+                    break
+            if mask is False:
+                continue
+            scanned += 1
+            rows += seg.rows
+            view = View(seg, mask)
+
+            # per group row counts, all in C
+            cols = [k for k in keys if k not in RUN_COLUMNS]
+            if cols:
+                counts = Counter(zip(*[view.values(k) for k in cols]))
+            else:
+                counts = {(): view.rows}
+
+            for raw_key, n in counts.items():
+                if not n:
+                    continue
+                it = iter(raw_key)
+                full = tuple(seg.run.get(k, "") if k in RUN_COLUMNS
+                             else next(it) for k in keys)
+                out = tuple(v if k in RUN_COLUMNS else label(seg, k, v)
+                            for k, v in zip(keys, full))
+                agg = groups.setdefault(out, Agg())
+                agg.count += n
+                if not value_cols:
+                    continue
+                gm = None
+                for k, v in zip(keys, full):
+                    if k not in RUN_COLUMNS:
+                        gm = and_mask(gm, value_mask(view, k, [v]),
+                                      view.rows)
+                for col in value_cols:
+                    if col in RUN_COLUMNS:
+                        continue
+                    code = "d" if seg.cols[col]["type"] == "d" else "q"
+                    vals = view.values(col)
+                    agg.add(col, code,
+                            vals if gm is None else compress(vals, gm))
+            seg.cache.clear()       # keep one segment's columns in memory
+    finally:
+        f.close()
+    return groups, scanned, rows
+
+
+def run_add(path):
+    run = {"run": find_opt("run", time.strftime("run-%Y%m%d-%H%M%S")),
+           "kernel": find_opt("kernel", os.uname().release),
+           "host": socket.gethostname(),
+           "mode": find_opt("mode", ""),
+           "ts": round(time.time(), 3)}
+
+    # injection events
+    inj = []
+    dmesg = find_opt("dmesg")
+    if dmesg or "--dmesg" in sys.argv[1:]:
+        if dmesg:
+            with open(dmesg, "r", errors="replace") as f:
+                text = f.read()
+        else:
+            text = subprocess.run(["dmesg"], capture_output=True, text=True,
+                                  errors="replace").stdout
+        inj = INJ_RE.findall(text)
+        if inj:
+            pid, comm, sym, old, new, ts, fault, delay, task, idx = zip(*inj)
+            new = list(map(int, new))
+            append_table(path, "inj", run, [
+                ("ts_ns", "delta", list(map(int, ts))),
+                ("symbol", "str", sym),
+                ("comm", "str", comm),
+                ("pid", "int", list(map(int, pid))),
+                ("task", "int", list(map(int, task))),
+                ("call_idx", "int", list(map(int, idx))),
+                ("old_ret", "int", list(map(int, old))),
+                ("new_ret", "int", new),
+                ("errno", "int", [-r if -4096 < r < 0 else 0 for r in new]),
+                ("fault", "int", list(map(int, fault))),
+                ("delay_us", "int", list(map(int, delay))),
+            ])
+        print(f"[ARCHIVE] inj: {len(inj)} events")
+
+    # server failures, and the whole-log summary
+    summary = {}
+    log = find_opt("server-log")
+    if log:
+        fails = []
+        with open(log, "r", errors="replace") as f:
+            for seq, line in enumerate(f):
+                m = FAIL_RE.search(line.rstrip("\n"))
+                if m:
+                    fails.append((seq, m.group(1), int(m.group(3)),
+                                  int(m.group(2)), m.group(4)))
+                    continue
+                m = LATENCY_RE.search(line)
+                if m:
+                    summary.update(p50_us=float(m.group(1)),
+                                   p99_us=float(m.group(2)))
+                m = CASCADE_RE.search(line)
+                if m:
+                    fail_iters, n, worst = map(int, m.groups()[1:])
+                    summary.update(fails=n, max_cascade=worst,
+                                   cascade=n / fail_iters if fail_iters
+                                   else 0.0)
+                    run["mode"] = run["mode"] or m.group(1)
+        if fails:
+            seq, sc, err, ret, detail = zip(*fails)
+            append_table(path, "fail", run, [
+                ("seq", "int", seq), ("sc", "str", sc), ("errno", "int", err),
+                ("ret", "int", ret), ("detail", "str", detail)])
+        print(f"[ARCHIVE] fail: {len(fails)} lines")
+
+    # variants: journal rows, or the log as one variant
+    variants = []
+    journal = find_opt("journal")
+    if journal:
+        cache = {}
+        cache_path = find_opt("outcome-cache")
+        if cache_path and os.path.exists(cache_path):
+            with open(cache_path, "r") as f:
+                cache = json.load(f).get("outcomes", {})
+        # injection times per errno, sorted: each variant's window is then
+        # two bisections instead of a pass over every event
+        inj_ts = defaultdict(list)
+        for e in inj:
+            inj_ts[-int(e[4])].append(int(e[5]))
+        for ts in inj_ts.values():
+            ts.sort()
+        started = {}
+        with open(journal, "r") as f:
+            for line in f:
+                try:
+                    rec = json.loads(line)
+                except ValueError:
+                    continue
+                key = (rec.get("syscall"), rec.get("errno"))
+                if rec.get("ev") == "start":
+                    started[key] = rec["ts"]
+                    continue
+                t0 = started.pop(key, rec["ts"])
+                num = getattr(errno, key[1] or "", 0)
+                ts = inj_ts.get(num, ())
+                n = (bisect_right(ts, rec["ts"] * 1e9) -
+                     bisect_left(ts, t0 * 1e9))
+                oc = cache.get(rec["outcome"], {})
+                variants.append((key[0], key[1], num, rec["outcome"],
+                                 oc.get("exit", "-"), n if inj else -1,
+                                 oc.get("cascade", -1), t0, rec["ts"] - t0))
+                run["mode"] = run["mode"] or key[0]
+    elif summary:
+        name = find_opt("errno", "-")
+        variants.append((run["mode"], name, getattr(errno, name, 0), "-",
+                         "-", len(inj) if inj else -1,
+                         summary.get("cascade", -1), run["ts"], -1.0))
+    if variants:
+        cols = list(zip(*variants))
+        n = len(variants)
+        one = summary if not journal else {}
+        append_table(path, "variant", run, [
+            ("syscall", "str", cols[0]), ("errno", "str", cols[1]),
+            ("errno_num", "int", cols[2]), ("outcome", "str", cols[3]),
+            ("exit", "str", cols[4]), ("injections", "int", cols[5]),
+            ("fails", "int", [one.get("fails", -1)] * n),
+            ("cascade", "float", [float(c) for c in cols[6]]),
+            ("max_cascade", "int", [one.get("max_cascade", -1)] * n),
+            ("p50_us", "float", [one.get("p50_us", -1.0)] * n),
+            ("p99_us", "float", [one.get("p99_us", -1.0)] * n),
+            ("t_start", "float", [float(t) for t in cols[7]]),
+            ("secs", "float", [float(s) for s in cols[8]])])
+    print(f"[ARCHIVE] variant: {len(variants)} rows")
+    print(f"[ARCHIVE] Appended run '{run['run']}' (kernel {run['kernel']}, "
+          f"mode {run['mode'] or '-'}) to {path}")
+
+
+def run_info(path):
+    f, segs = open_archive(path)
+    f.close()
+    tables = {}
+    for seg in segs:
+        t = tables.setdefault(seg.table, {"segments": 0, "rows": 0,
+                                          "runs": set(), "bytes": 0})
+        t["segments"] += 1
+        t["rows"] += seg.rows
+        t["runs"].add(seg.run.get("run"))
+        t["bytes"] += sum(c["len"] for c in seg.cols.values())
+    for name, t in sorted(tables.items()):
+        cols = next(s for s in segs if s.table == name).cols
+        print(f"[ARCHIVE] {name}: rows={t['rows']} segments={t['segments']} "
+              f"runs={len(t['runs'])} bytes={t['bytes']} "
+              f"({t['bytes'] / max(t['rows'], 1):.2f}/row)")
+        print(f"[ARCHIVE]   columns: {', '.join(list(cols) + list(RUN_COLUMNS))}")
+
+
+def fmt(v):
+    if isinstance(v, float):
+        return f"{v:.2f}"
+    return "-" if v is None else str(v)
+
+
+def main():
+    args = [a for a in sys.argv[1:] if not a.startswith("--")]
+    if len(args) != 2 or args[0] not in ("add", "query", "info"):
+        print(__doc__.strip().split("Usage: ")[-1], file=sys.stderr)
+        sys.exit(1)
+    cmd, path = args
+
+    if cmd == "add":
+        run_add(path)
+        return
+    if cmd == "info":
+        run_info(path)
+        return
+
+    table = find_opt("table")
+    if table not in ("inj", "fail", "variant"):
+        print("[ARCHIVE] ERROR: --table=inj|fail|variant", file=sys.stderr)
+        sys.exit(1)
+    keys = [k for k in find_opt("by", "").split(",") if k]
+    aggs = [a for a in find_opt("agg", "count").split(",") if a]
+    for a in aggs:
+        if a != "count" and not re.match(r"^(sum|mean|min|max|p[\d.]+):\w+$",
+                                         a):
+            print(f"[ARCHIVE] ERROR: bad --agg '{a}'", file=sys.stderr)
+            sys.exit(1)
+    sort = find_opt("sort", aggs[0])
+    limit = find_int_opt("limit", 0)
+
+    t0 = time.time()
+    try:
+        groups, scanned, rows = run_query(
+            path, table, parse_where(find_opt("where")), keys, aggs)
+    except ValueError as e:
+        print(f"[ARCHIVE] ERROR: {e}", file=sys.stderr)
+        sys.exit(1)
+    secs = time.time() - t0
+
+    table_rows = [(key, [agg.result(a) for a in aggs])
+                  for key, agg in groups.items()]
+    if sort in aggs:
+        i = aggs.index(sort)
+        table_rows.sort(key=lambda r: (r[1][i] is not None, r[1][i] or 0),
+                        reverse=True)
+    else:
+        table_rows.sort()
+    if limit:
+        table_rows = table_rows[:limit]
+
+    print("[ARCHIVE] " + " ".join(f"{c:>14}" for c in keys + aggs))
+    for key, vals in table_rows:
+        print("[ARCHIVE] " + " ".join(f"{fmt(v):>14}"
+                                      for v in list(key) + vals))
+    print(f"[ARCHIVE] {len(table_rows)} groups, {rows} rows in {scanned} "
+          f"segments scanned, {secs:.2f}s")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,300 @@
+#!/usr/bin/env python3
+"""
+Syscall/errno catalogue: normalized JSON source plus a compiled binary index.
+
+json/catalogue.json (written by generate_fs_json.py) keeps each errno set
+once, by id, and per-syscall entries refer to it:
+
+    {
+      "version": 1,
+      "default_errno_set": "fs",
+      "errno_sets": {"fs": ["EPERM", "EACCES", ...]},
+      "syscalls": {
+        "openat": {"symbol": "__x64_sys_openat", "path_spec": "d0p1"},
+        "read":   {"symbol": "__x64_sys_read", "count_arg": 2,
+                   "errnos_remove": ["EISDIR"]},
+        ...
+      }
+    }
+
+Per-syscall overrides: "errno_set" (another set id), "errnos" (explicit
+list, replaces the set), "errnos_add" and "errnos_remove". "probes" lists
+kernel functions on the syscall's internal path (controller.py --probe=);
+a ":vmfault" suffix marks one that returns vm_fault_t.
+
+json/catalogue.idx is the same data compiled for mmap and O(1) lookup by
+name. All integers are little-endian:
+
+    header   "FSCATIDX" u32 version, u32 nslots, u32 nentries,
+             u32 slots_off, u32 records_off
+    slots    nslots x u32 record offset (0 = empty), FNV-1a of the name,
+             linear probing
+    record   u32 name, u32 symbol, u32 path_spec, u32 errset, u32 probes
+             (offsets, 0 = none; probes comma separated), i8 count_arg
+             (-1 = none), u8 flags, u16 pad
+    errset   u32 n, then n x (u16 errno, u16 pad, u32 name offset);
+             identical resolved sets are stored once
+    strings  NUL-terminated
+
+The index is rebuilt automatically when it is older than the JSON source
+or was written by another version.
+"""
+import errno
+import json
+import mmap
+import os
+import struct
+
+BASE_DIR = os.path.dirname(os.path.abspath(__file__))
+ROOT_DIR = os.path.abspath(os.path.join(BASE_DIR, ".."))
+
+CATALOGUE_PATH = os.path.join(ROOT_DIR, "json", "catalogue.json")
+INDEX_PATH = os.path.join(ROOT_DIR, "json", "catalogue.idx")
+
+MAGIC = b"FSCATIDX"
+VERSION = 2
+HEADER = struct.Struct("<8sIIIII")
+SLOT = struct.Struct("<I")
+RECORD = struct.Struct("<IIIIIbBH")
+ERRSET_LEN = struct.Struct("<I")
+ERRSET_ENT = struct.Struct("<HHI")
+
+FLAG_PROBEABLE = 1
+
+
+def fnv1a(data):
+    h = 0x811c9dc5
+    for b in data:
+        h = ((h ^ b) * 0x01000193) & 0xffffffff
+    return h
+
+
+def resolve_errnos(cat, entry):
+    """
+    Errno names for one syscall entry after applying its overrides.
+    """
+    if "errnos" in entry:
+        names = list(entry["errnos"])
+    else:
+        set_id = entry.get("errno_set", cat.get("default_errno_set"))
+        names = list(cat["errno_sets"].get(set_id, []))
+    names += [n for n in entry.get("errnos_add", []) if n not in names]
+    drop = set(entry.get("errnos_remove", []))
+    return [n for n in names if n not in drop and hasattr(errno, n)]
+
+
+def compile_index(src=CATALOGUE_PATH, dst=INDEX_PATH):
+    """
+    Compile catalogue.json into the binary index; written via rename so
+    readers with the old file mapped are unaffected.
+    """
+    with open(src, "r") as f:
+        cat = json.load(f)
+    syscalls = cat["syscalls"]
+
+    nslots = 1
+    while nslots < 2 * len(syscalls):
+        nslots <<= 1
+    slots_off = HEADER.size
+    records_off = slots_off + nslots * SLOT.size
+    blob_off = records_off + len(syscalls) * RECORD.size
+
+    blob = bytearray()
+    strings = {}
+    errsets = {}
+
+    def string(s):
+        if s is None:
+            return 0
+        if s not in strings:
+            strings[s] = blob_off + len(blob)
+            blob.extend(s.encode() + b"\0")
+        return strings[s]
+
+    def errset(names):
+        key = tuple(names)
+        if key not in errsets:
+            name_offs = [string(n) for n in names]
+            while len(blob) % 4:
+                blob.append(0)
+            errsets[key] = blob_off + len(blob)
+            blob.extend(ERRSET_LEN.pack(len(names)))
+            for n, off in zip(names, name_offs):
+                blob.extend(ERRSET_ENT.pack(getattr(errno, n), 0, off))
+        return errsets[key]
+
+    slots = [0] * nslots
+    records = bytearray()
+    for name, entry in syscalls.items():
+        rec_off = records_off + len(records)
+        sym = entry.get("symbol")
+        count_arg = entry.get("count_arg")
+        records.extend(RECORD.pack(
+            string(name), string(sym), string(entry.get("path_spec")),
+            errset(resolve_errnos(cat, entry)),
+            string(",".join(entry["probes"]) if entry.get("probes") else None),
+            -1 if count_arg is None else count_arg,
+            FLAG_PROBEABLE if sym else 0, 0))
+        h = fnv1a(name.encode()) & (nslots - 1)
+        while slots[h]:
+            h = (h + 1) & (nslots - 1)
+        slots[h] = rec_off
+
+    out = bytearray(HEADER.pack(MAGIC, VERSION, nslots, len(syscalls),
+                                slots_off, records_off))
+    for off in slots:
+        out.extend(SLOT.pack(off))
+    out.extend(records)
+    out.extend(blob)
+
+    tmp = dst + ".tmp"
+    with open(tmp, "wb") as f:
+        f.write(out)
+    os.replace(tmp, dst)
+    return len(syscalls)
+
+
+def apply_discovery(observed, keep=(), src=CATALOGUE_PATH, write=True):
+    """
+    Prune each discovered syscall's errnos to those its scenario produced
+    under perturbation (plus `keep`, for errnos a sandbox cannot provoke)
+    and add produced errnos the catalogue lacked. observed maps syscall
+    name -> set of errno numbers. Returns {name: (before, after)}.
+    """
+    with open(src, "r") as f:
+        cat = json.load(f)
+
+    changes = {}
+    for name, nums in observed.items():
+        entry = cat["syscalls"].get(name)
+        if entry is None:
+            continue
+        before = resolve_errnos(cat, entry)
+        seen = {errno.errorcode[n] for n in nums if n in errno.errorcode}
+        # errorcode picks one alias (ENOTSUP/EOPNOTSUPP); match by number
+        after = [n for n in before if getattr(errno, n) in nums or n in keep]
+        after += sorted(n for n in seen
+                        if getattr(errno, n) not in
+                        {getattr(errno, a) for a in after})
+        entry["errnos"] = after
+        entry["discovered"] = sorted(seen)
+        entry.pop("errnos_add", None)
+        entry.pop("errnos_remove", None)
+        changes[name] = (before, after)
+
+    if write:
+        tmp = src + ".tmp"
+        with open(tmp, "w") as f:
+            json.dump(cat, f, indent=1)
+            f.write("\n")
+        os.replace(tmp, src)
+        compile_index(src)
+    return changes
+
+
+class Catalogue:
+    """
+    Read-only view of catalogue.idx. Supports the dict operations the
+    controller uses on its metadata (in, [], get, values, items); entries
+    are decoded on demand into the classic entry shape.
+    """
+
+    def __init__(self, path=INDEX_PATH):
+        with open(path, "rb") as f:
+            self.buf = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        (magic, version, self.nslots, self.nentries, self.slots_off,
+         self.records_off) = HEADER.unpack_from(self.buf, 0)
+        if magic != MAGIC or version != VERSION:
+            raise ValueError(f"{path}: not a version {VERSION} catalogue index")
+
+    def _str(self, off):
+        if not off:
+            return None
+        end = self.buf.find(b"\0", off)
+        return self.buf[off:end].decode()
+
+    def _record(self, rec_off):
+        name, sym, spec, eset, probes, count_arg, flags, _ = \
+            RECORD.unpack_from(self.buf, rec_off)
+        variants = []
+        if eset:
+            (n,) = ERRSET_LEN.unpack_from(self.buf, eset)
+            for i in range(n):
+                num, _, ename = ERRSET_ENT.unpack_from(
+                    self.buf, eset + ERRSET_LEN.size + i * ERRSET_ENT.size)
+                variants.append({"errno_name": self._str(ename),
+                                 "errno_num": num, "kernel_ret": -num})
+        sym = self._str(sym)
+        probes = self._str(probes)
+        return {
+            "name": self._str(name),
+            "canonical_guess": sym,
+            "symbol_to_probe": None,
+            "probeable": bool(flags & FLAG_PROBEABLE),
+            "category": "file",
+            "count_arg": None if count_arg < 0 else count_arg,
+            "path_spec": self._str(spec),
+            "error_variants": variants,
+            "probes": probes.split(",") if probes else [],
+        }
+
+    def _find(self, name):
+        key = name.encode()
+        h = fnv1a(key) & (self.nslots - 1)
+        for _ in range(self.nslots):
+            (rec_off,) = SLOT.unpack_from(self.buf,
+                                          self.slots_off + h * SLOT.size)
+            if not rec_off:
+                return None
+            (name_off,) = struct.unpack_from("<I", self.buf, rec_off)
+            if self.buf[name_off:name_off + len(key) + 1] == key + b"\0":
+                return rec_off
+            h = (h + 1) & (self.nslots - 1)
+        return None
+
+    def __contains__(self, name):
+        return self._find(name) is not None
+
+    def __getitem__(self, name):
+        rec_off = self._find(name)
+        if rec_off is None:
+            raise KeyError(name)
+        return self._record(rec_off)
+
+    def get(self, name, default=None):
+        rec_off = self._find(name)
+        return default if rec_off is None else self._record(rec_off)
+
+    def values(self):
+        for i in range(self.nentries):
+            yield self._record(self.records_off + i * RECORD.size)
+
+    def items(self):
+        for entry in self.values():
+            yield entry["name"], entry
+
+
+def open_catalogue():
+    """
+    Map the index, compiling it first if it is missing or stale.
+    """
+    try:
+        src_mtime = os.path.getmtime(CATALOGUE_PATH)
+    except OSError:
+        return Catalogue()      # shipped index without its source
+    try:
+        stale = os.path.getmtime(INDEX_PATH) < src_mtime
+    except OSError:
+        stale = True
+    if stale:
+        compile_index()
+    try:
+        return Catalogue()
+    except ValueError:
+        compile_index()     # index from an older layout
+        return Catalogue()
+
+
+if __name__ == "__main__":
+    n = compile_index()
+    print(f"[CAT] Compiled {n} syscalls into {INDEX_PATH}")
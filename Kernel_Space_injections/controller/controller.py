@@ -3,39 +3,106 @@ import os
 import sys
 import json
 import time
+import errno
+import signal
 import subprocess
 
+from catalogue import CATALOGUE_PATH, apply_discovery, open_catalogue
+from outcomes import OutcomeCache, OutcomeRun, syscall_class
+
 # ---- PATH CONFIG (adjust if needed) ----
 
 BASE_DIR = os.path.dirname(os.path.abspath(__file__))  # test1/controller
 ROOT_DIR = os.path.abspath(os.path.join(BASE_DIR, ".."))
 
-JSON_PATH = os.path.join(ROOT_DIR, "json", "file_system.json")
-
 MODULE_PATH = os.path.join(ROOT_DIR, "reader", "fs_injector.ko")
 MODULE_NAME = "fs_injector"
 SYSFS_BASE = f"/sys/module/{MODULE_NAME}/parameters"
+DEBUGFS_BASE = f"/sys/kernel/debug/{MODULE_NAME}"
+
+SERVER_DIR = os.path.join(ROOT_DIR, "server")
+SERVER_PATH = os.path.join(SERVER_DIR, "server")
+SERVER_COMM = "server"
 
 
 # ---- HELPER: filesystem metadata ----
 
 def load_fs_metadata():
     """
-    Load file_system.json and index entries by syscall name.
-    Only entries with category == "file" are kept.
+    Map the compiled catalogue index (json/catalogue.idx). Lookups by
+    syscall name are O(1) and only decode the entry asked for.
     """
-    with open(JSON_PATH, "r") as f:
-        data = json.load(f)
+    return open_catalogue()
+
+
+def path_specs_for(fs_meta, symbols):
+    """
+    Build the module's path_spec ("sym=d0p1;sym=f0") for the hooked symbols.
+    """
+    by_symbol = {}
+    for entry in fs_meta.values():
+        sym = entry.get("symbol_to_probe") or entry.get("canonical_guess")
+        if sym and entry.get("path_spec"):
+            by_symbol[sym] = entry["path_spec"]
+    rules = [f"{sym}={by_symbol[sym]}" for sym in symbols.split(",")
+             if sym in by_symbol]
+    return ";".join(rules)
+
+
+def internal_probes(entry, which):
+    """
+    Symbols for --probe=all|NAME[,NAME]: kernel functions on the entry's
+    page-cache/writeback path (catalogue "probes"), hooked instead of the
+    syscall itself.
+    """
+    known = [p.split(":")[0] for p in entry.get("probes") or []]
+    wanted = known if which == "all" else which.split(",")
+    unknown = [w for w in wanted if w not in known]
+    if unknown or not wanted:
+        print(f"[CTRL] ERROR: --probe={which}: '{entry['name']}' has probes "
+              f"{','.join(known) or '(none)'}", file=sys.stderr)
+        sys.exit(1)
+    return ",".join(wanted)
+
+
+def vmfault_symbols_for(symbols):
+    """
+    The hooked symbols the catalogue marks as returning vm_fault_t.
+    """
+    marked = {p.split(":")[0] for entry in load_fs_metadata().values()
+              for p in entry.get("probes") or [] if p.endswith(":vmfault")}
+    return ",".join(s for s in symbols.split(",") if s in marked)
 
-    by_name = {}
-    for entry in data:
-        if entry.get("category") != "file":
-            continue
-        name = entry.get("name")
-        if not name:
-            continue
-        by_name[name] = entry
-    return by_name
+
+def errno_bitmap(nums):
+    """
+    Kernel bitmap_parse() text for a set of errno numbers: hex, 32-bit
+    words comma separated, most significant first.
+    """
+    mask = sum(1 << n for n in nums)
+    words = []
+    while mask or not words:
+        words.append(mask & 0xffffffff)
+        mask >>= 32
+    words.reverse()
+    return ",".join([f"{words[0]:x}"] + [f"{w:08x}" for w in words[1:]])
+
+
+def errno_allow_for(symbols):
+    """
+    The module's errno_allow ("sym=bitmap;...") for the hooked symbols: the
+    catalogue's error variants of every entry probing each symbol. Symbols
+    the catalogue does not know stay unrestricted.
+    """
+    allowed = {}
+    for entry in load_fs_metadata().values():
+        sym = entry.get("symbol_to_probe") or entry.get("canonical_guess")
+        variants = entry.get("error_variants") or []
+        if sym and variants:
+            allowed.setdefault(sym, set()).update(
+                ev["errno_num"] for ev in variants)
+    return ";".join(f"{sym}={errno_bitmap(allowed[sym])}"
+                    for sym in symbols.split(",") if sym in allowed)
 
 
 # ---- HELPER: find running server and its mode ----
@@ -54,6 +121,28 @@ def find_server_pid_explicit():
     return None
 
 
+def find_opt(name, default=None):
+    """
+    Return the value of a --name=value argument, or default.
+    """
+    prefix = f"--{name}="
+    for arg in sys.argv[1:]:
+        if arg.startswith(prefix):
+            return arg[len(prefix):]
+    return default
+
+
+def find_int_opt(name, default):
+    value = find_opt(name)
+    if value is None:
+        return default
+    try:
+        return int(value)
+    except ValueError:
+        print(f"[CTRL] Invalid --{name} value: {value}", file=sys.stderr)
+        sys.exit(1)
+
+
 def find_server_pid_auto():
     """
     Automatically find a running 'server' process using pidof.
@@ -99,26 +188,61 @@ def rmmod_module():
                    stderr=subprocess.DEVNULL)
 
 
-def insmod_module(symbol, pid, max_inj=1000, unsafe=1):
+def insmod_module(symbol, pid, max_inj=1000, unsafe=1, every=1, extra=None):
     """
     Insert fs_injector.ko with given symbol and target PID.
+    every=N injects on every Nth eligible call (fault rate 1/N).
+    extra is a dict of additional module parameters; it may also override
+    the defaults below.
     """
     rmmod_module()
-    args = [
-        "insmod",
-        MODULE_PATH,
-        f"target_symbol={symbol}",
-        f"target_pid={pid}",
-        f"inject_errno=1",       # will be changed per variant
-        f"max_injections={max_inj}",
-        f"unsafe_mode={unsafe}",
-    ]
+    params = {
+        "target_symbol": symbol,
+        "target_pid": pid,
+        "inject_errno": 1,       # will be changed per variant
+        "max_injections": max_inj,
+        "unsafe_mode": unsafe,
+        "inject_every": every,
+    }
+    vmfault = vmfault_symbols_for(symbol)
+    if vmfault:
+        params["vmfault_symbols"] = vmfault
+    if "--no-errno-allow" not in sys.argv[1:]:
+        allow = errno_allow_for(symbol)
+        if allow:
+            params["errno_allow"] = allow
+    params.update(extra or {})
+    args = ["insmod", MODULE_PATH] + [f"{k}={v}" for k, v in params.items()]
     print(f"[CTRL] insmod: {' '.join(args)}")
     subprocess.run(args, check=True)
     # small delay to let sysfs params appear
     time.sleep(0.1)
 
 
+def cgroup_ids(paths):
+    """
+    cgroup v2 id of each directory: the kernfs node id, which is the inode
+    number of the cgroup directory.
+    """
+    ids = []
+    for path in paths.split(","):
+        if not path:
+            continue
+        if not os.path.isabs(path):
+            path = os.path.join("/sys/fs/cgroup", path)
+        ids.append(str(os.stat(path).st_ino))
+    return ",".join(ids)
+
+
+def set_cgroups(ids):
+    """
+    Retarget a loaded module at runtime; "" removes the cgroup filter.
+    """
+    path = os.path.join(SYSFS_BASE, "target_cgroups")
+    with open(path, "w") as f:
+        f.write(f"{ids}\n")
+
+
 def read_param(name):
     path = os.path.join(SYSFS_BASE, name)
     with open(path, "r") as f:
@@ -131,6 +255,68 @@ def write_param(name, value):
         f.write(f"{value}\n")
 
 
+def read_schedule():
+    with open(os.path.join(DEBUGFS_BASE, "schedule"), "r") as f:
+        return f.read()
+
+
+def write_schedule(lines):
+    """
+    Load replay entries. The module parses whole lines, at most a page less
+    one byte per write, and copies its table on every write: batch them.
+    """
+    limit = os.sysconf("SC_PAGE_SIZE") - 1
+    fd = os.open(os.path.join(DEBUGFS_BASE, "schedule"), os.O_WRONLY)
+    try:
+        batch = b"clear\n"
+        for line in lines:
+            data = (line.rstrip("\n") + "\n").encode()
+            if len(batch) + len(data) > limit:
+                os.write(fd, batch)
+                batch = b""
+            batch += data
+        if batch:
+            os.write(fd, batch)
+    finally:
+        os.close(fd)
+
+
+def read_errors():
+    """
+    Natural-return baseline from debugfs, as the raw text (see edi.py)
+    """
+    with open(os.path.join(DEBUGFS_BASE, "errors"), "r") as f:
+        return f.read()
+
+
+def read_callsites():
+    """
+    Per-call-site hit table: [(fingerprint, symbol, hits, injected, frames)]
+    """
+    sites = []
+    with open(os.path.join(DEBUGFS_BASE, "callsites"), "r") as f:
+        for line in f:
+            if line.startswith("#") or not line.strip():
+                continue
+            fp, sym, hits, inj, *frames = line.split()
+            sites.append((fp, sym, int(hits), int(inj), frames))
+    sites.sort(key=lambda s: -s[2])
+    return sites
+
+
+def print_callsites(limit=20):
+    try:
+        sites = read_callsites()
+    except OSError as e:
+        print(f"[CTRL] WARNING: could not read call sites: {e}",
+              file=sys.stderr)
+        return
+    print(f"[CTRL] Call sites ({len(sites)} seen, top {limit} by hits):")
+    for fp, sym, hits, inj, frames in sites[:limit]:
+        print(f"[CTRL]  {fp} {sym} hits={hits} injected={inj} "
+              f"frames={','.join(frames)}")
+
+
 def wait_for_injection(prev_count, timeout_sec=5.0):
     """
     Poll injections_done until it increases beyond prev_count or timeout.
@@ -148,46 +334,964 @@ def wait_for_injection(prev_count, timeout_sec=5.0):
     return False
 
 
-# ---- MAIN CONTROL FLOW ----
+# ---- CAMPAIGN CONTEXT ----
 
-def main():
-    # 1) Find server PID
-    pid = find_server_pid_explicit()
-    if pid is None:
-        pid = find_server_pid_auto()
+class Campaign:
+    """
+    One module load against one server. The server is either attached by
+    PID (already running) or launched by us after insmod, filtered by comm,
+    so per-task call indices count from process start and a recorded
+    schedule can be replayed exactly.
+    """
+
+    def __init__(self, mode, pid=None, launch=False, every=1,
+                 record_path=None, server_args=(), path_filter=None,
+                 cgroups=None, callsite=None, baseline_path=None):
+        self.mode = mode
+        self.pid = pid
+        self.launch = launch
+        self.every = every
+        self.record_path = record_path
+        self.server_args = list(server_args)
+        self.proc = None
+        self.extra = {}
+        # (prefixes, fs_meta) for the path-prefix filter, or None
+        self.path_filter = path_filter
+        # comma list of cgroup ids; targets every task in them
+        self.cgroups = cgroups
+        # (depth, comma list of fingerprints or None), or None
+        self.callsite = callsite
+        # where to save the natural-errno histograms at the end
+        self.baseline_path = baseline_path
+        # launched server's stdout goes here when outcomes are fingerprinted
+        self.log_path = None
+
+    def load_module(self, symbol, max_inj=1000, unsafe=1, extra=None):
+        params = dict(extra or {})
+        if self.launch:
+            params["target_comm"] = SERVER_COMM
+        if self.record_path:
+            params["record"] = 1
+        if self.cgroups:
+            params["target_cgroups"] = self.cgroups
+        if self.callsite:
+            depth, fps = self.callsite
+            params["callsite_depth"] = depth
+            if fps:
+                params["target_callsites"] = fps
+        if self.path_filter:
+            prefixes, fs_meta = self.path_filter
+            params["path_prefixes"] = prefixes
+            params["path_spec"] = path_specs_for(fs_meta, symbol)
+        self.extra = params
+        # pid None without launch/cgroups means system-wide
+        insmod_module(symbol, 0 if self.launch or not self.pid else self.pid,
+                      max_inj=max_inj, unsafe=unsafe, every=self.every,
+                      extra=params)
+        if self.launch:
+            self.start_server()
+
+    def start_server(self):
+        args = [SERVER_PATH, f"--mode={self.mode}"] + self.server_args
+        if self.callsite:
+            # fingerprints hash raw addresses: keep the layout fixed
+            args = ["setarch", os.uname().machine, "-R"] + args
+        print(f"[CTRL] launch: {' '.join(args)}")
+        out = open(self.log_path, "wb") if self.log_path else None
+        self.proc = subprocess.Popen(args, cwd=SERVER_DIR, stdout=out)
+        if out:
+            out.close()
+        self.pid = self.proc.pid
+
+    def output_offset(self):
+        return os.path.getsize(self.log_path)
+
+    def output_since(self, offset):
+        with open(self.log_path, "rb") as f:
+            f.seek(offset)
+            return f.read().decode(errors="replace").splitlines()
+
+    def exit_state(self):
+        if not self.proc or self.proc.poll() is None:
+            return "running"
+        code = self.proc.returncode
+        return f"signal:{-code}" if code < 0 else f"exit:{code}"
+
+    def stop_server(self):
+        if not self.proc:
+            return
+        self.proc.terminate()
+        try:
+            self.proc.wait(timeout=5)
+        except subprocess.TimeoutExpired:
+            self.proc.kill()
+            self.proc.wait()
+        self.proc = None
 
-    if pid is None:
-        print("[CTRL] ERROR: No running 'server' process found. "
-              "Start './server --mode=...' first.", file=sys.stderr)
+    def save_schedule(self):
+        text = read_schedule()
+        header = f"# mode={self.mode}"
+        if "count_arg" in self.extra:
+            header += f" count_arg={self.extra['count_arg']}"
+        with open(self.record_path, "w") as f:
+            f.write(header + "\n" + text)
+        n = sum(1 for l in text.splitlines() if l and not l.startswith("#"))
+        dropped = schedule_dropped(text)
+        if dropped:
+            print(f"[CTRL] ERROR: schedule is incomplete: recorded {n} "
+                  f"injections to {self.record_path}, {dropped} more did not "
+                  f"fit in the module's table", file=sys.stderr)
+            return
+        print(f"[CTRL] Recorded {n} injections to {self.record_path}")
+
+    def save_baseline(self):
+        text = read_errors()
+        with open(self.baseline_path, "w") as f:
+            f.write(f"# mode={self.mode}\n" + text)
+        print(f"[CTRL] Saved natural-error baseline to {self.baseline_path}")
+
+    def finish(self):
+        try:
+            if self.record_path:
+                self.save_schedule()
+            if self.baseline_path:
+                self.save_baseline()
+        except OSError as e:
+            print(f"[CTRL] WARNING: could not save results: {e}",
+                  file=sys.stderr)
+        if self.callsite:
+            print_callsites()
+        self.stop_server()
+        rmmod_module()
+        print("[CTRL] Done. Module unloaded.")
+
+
+class Journal:
+    """
+    Append-only, fsync'd record of a variant sweep, one JSON line per event:
+    {"ev": "start"|"done", "syscall", "errno", "outcome", "ts"}. A "start"
+    without its "done" means the kernel died while that variant ran; on
+    reopen it is closed as outcome "crash" and never rerun. A variant the
+    controller itself abandoned (Ctrl-C, SIGTERM, an error) is closed as
+    "interrupted" and rerun.
+    """
+
+    def __init__(self, path, syscall):
+        self.path = path
+        self.syscall = syscall
+        self.done = {}
+        self.active = None
+        running = None
+        if os.path.exists(path):
+            with open(path, "r") as f:
+                for line in f:
+                    try:
+                        rec = json.loads(line)
+                    except ValueError:
+                        continue        # torn write from the crash
+                    if rec.get("syscall") != syscall:
+                        continue
+                    if rec["ev"] == "start":
+                        running = rec["errno"]
+                    else:
+                        if rec["outcome"] == "interrupted":
+                            self.done.pop(rec["errno"], None)
+                        else:
+                            self.done[rec["errno"]] = rec["outcome"]
+                        running = None
+        created = not os.path.exists(path)
+        torn = False
+        if not created and os.path.getsize(path):
+            with open(path, "rb") as f:
+                f.seek(-1, os.SEEK_END)
+                torn = f.read(1) != b"\n"
+        self.f = open(path, "a")
+        if torn:
+            # finish the torn line so the next record starts on its own
+            self.f.write("\n")
+        if created:
+            # make the new directory entry durable too
+            dfd = os.open(os.path.dirname(os.path.abspath(path)), os.O_RDONLY)
+            os.fsync(dfd)
+            os.close(dfd)
+        if running:
+            print(f"[CTRL] Journal: {syscall}/{running} was running at "
+                  f"crash time, recording it as crash-inducing")
+            self.finish(running, "crash")
+
+    def append(self, rec):
+        rec["syscall"] = self.syscall
+        rec["ts"] = round(time.time(), 3)
+        self.f.write(json.dumps(rec) + "\n")
+        self.f.flush()
+        os.fsync(self.f.fileno())
+
+    def start(self, errno_name):
+        self.active = errno_name
+        self.append({"ev": "start", "errno": errno_name})
+
+    def finish(self, errno_name, outcome):
+        self.active = None
+        self.done[errno_name] = outcome
+        self.append({"ev": "done", "errno": errno_name, "outcome": outcome})
+
+    def close(self):
+        # the process is alive, so an unfinished variant did not crash it
+        if self.active:
+            print(f"[CTRL] Journal: {self.syscall}/{self.active} "
+                  f"interrupted, it will be rerun")
+            self.finish(self.active, "interrupted")
+        self.f.close()
+
+
+def schedule_dropped(text):
+    """
+    Injections the module could not record (header "dropped=N").
+    """
+    for line in text.splitlines():
+        if line.startswith("#"):
+            for tok in line[1:].split():
+                if tok.startswith("dropped="):
+                    return int(tok.split("=", 1)[1])
+    return 0
+
+
+def parse_schedule_header(path):
+    """
+    Return (header dict, entry lines) of a recorded schedule file.
+    """
+    header, lines = {}, []
+    with open(path, "r") as f:
+        for line in f:
+            line = line.strip()
+            if not line:
+                continue
+            if line.startswith("#"):
+                for tok in line[1:].split():
+                    if "=" in tok:
+                        k, v = tok.split("=", 1)
+                        header[k] = v
+                continue
+            lines.append(line)
+    return header, lines
+
+
+# ---- REPLAY ----
+
+def run_replay(path):
+    """
+    Re-run a recorded schedule: launch a fresh server and inject exactly at
+    the recorded (task, symbol, call index) points.
+    """
+    header, lines = parse_schedule_header(path)
+    mode = find_opt("mode", header.get("mode"))
+    symbols = header.get("symbols")
+    if not mode or not symbols:
+        print(f"[CTRL] ERROR: {path} lacks mode=/symbols= header",
+              file=sys.stderr)
+        sys.exit(1)
+    if int(header.get("dropped", 0)):
+        print(f"[CTRL] ERROR: {path} is incomplete: {header['dropped']} "
+              f"injections were not recorded", file=sys.stderr)
         sys.exit(1)
 
-    print(f"[CTRL] Using server PID: {pid}")
+    extra = {"replay": 1, "fault_mode": header.get("fault_mode", 0)}
+    if "count_arg" in header:
+        extra["count_arg"] = header["count_arg"]
+
+    timeout = find_int_opt("duration", 30)
+    settle = find_int_opt("settle", 2)
 
-    # 2) Detect mode from /proc/<pid>/cmdline
+    print(f"[CTRL] Replaying {len(lines)} injections: mode={mode} "
+          f"symbols={symbols}")
+
+    ctx = Campaign(mode, launch=True, server_args=server_args())
     try:
-        mode = read_server_mode_from_cmdline(pid)
-    except RuntimeError as e:
+        # Load the schedule between insmod and launch, so no call is missed
+        insmod_module(symbols, 0, max_inj=1 << 30, unsafe=1,
+                      extra=dict(extra, target_comm=SERVER_COMM))
+        write_schedule(lines)
+        ctx.start_server()
+
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            if read_param("injections_done") >= len(lines):
+                break
+            time.sleep(0.05)
+        done = read_param("injections_done")
+        print(f"[CTRL]  Replayed {done}/{len(lines)} injections")
+        time.sleep(settle)
+    finally:
+        ctx.finish()
+
+
+# ---- SHORT-COUNT (PARTIAL I/O) CAMPAIGN ----
+
+def run_short_campaign(ctx, entry, symbol):
+    """
+    Clamp the length argument of a byte-count syscall instead of failing it.
+    The server's retry loops report the cost as retries= and Bps=.
+    """
+    count_arg = entry.get("count_arg")
+    if count_arg is None:
+        print(f"[CTRL] ERROR: '{entry.get('name')}' has no count_arg; "
+              f"short-count mode needs a byte-count syscall", file=sys.stderr)
+        sys.exit(1)
+
+    pct = find_int_opt("short-pct", 50)
+    cap = find_int_opt("short-cap", 0)
+    duration = find_int_opt("duration", 10)
+
+    print(f"[CTRL] Short-count mode: pct={pct} cap={cap} "
+          f"count_arg={count_arg} duration={duration}s")
+
+    try:
+        ctx.load_module(symbol, max_inj=1 << 30, extra={
+            "fault_mode": 1,
+            "short_pct": pct,
+            "short_cap": cap,
+            "count_arg": count_arg,
+        })
+    except subprocess.CalledProcessError as e:
+        print(f"[CTRL] ERROR: insmod failed: {e}", file=sys.stderr)
+        sys.exit(1)
+
+    try:
+        time.sleep(duration)
+        print(f"[CTRL]  Short transfers injected: "
+              f"{read_param('injections_done')}")
+    finally:
+        ctx.finish()
+
+
+# ---- LATENCY-FAULT CAMPAIGN ----
+
+def run_delay_campaign(ctx, symbol):
+    """
+    Delay returns instead of failing them. --delay is either a single
+    distribution applied to every hooked symbol ("5ms", "p50:200,p99:50ms")
+    or per-symbol rules ("__x64_sys_fsync=p99:50ms;__x64_sys_openat=100").
+    The server's LATENCY lines show how the tail propagates.
+    """
+    spec = find_opt("delay")
+    if not spec:
+        print("[CTRL] ERROR: --fault=delay needs --delay=SPEC", file=sys.stderr)
+        sys.exit(1)
+
+    spin = find_int_opt("delay-spin-us", 100)
+    duration = find_int_opt("duration", 10)
+
+    print(f"[CTRL] Delay mode: spec={spec} spin_us={spin} "
+          f"duration={duration}s")
+
+    try:
+        ctx.load_module(symbol, max_inj=1 << 30, extra={
+            "fault_mode": 2,
+            "delay_spec": spec,
+            "delay_spin_us": spin,
+        })
+    except subprocess.CalledProcessError as e:
+        print(f"[CTRL] ERROR: insmod failed: {e}", file=sys.stderr)
+        sys.exit(1)
+
+    try:
+        time.sleep(duration)
+        print(f"[CTRL]  Delayed returns injected: "
+              f"{read_param('injections_done')}")
+    finally:
+        ctx.finish()
+
+
+# ---- MULTI-FAULT CHAIN CAMPAIGN ----
+
+def chain_spec_for(fs_meta, text):
+    """
+    Translate --chain=openat:EMFILE,close:EIO*2 into the module's
+    chain_spec ("__x64_sys_openat:24,__x64_sys_close:5*2"). Steps name a
+    catalogue syscall or a raw kernel symbol, and an errno name or number.
+    """
+    steps = []
+    for step in text.split(","):
+        if not step:
+            continue
+        name, _, err = step.partition(":")
+        err, _, count = err.partition("*")
+        if not name or not err:
+            raise ValueError(f"bad chain step '{step}'")
+        if name in fs_meta:
+            entry = fs_meta[name]
+            name = entry.get("symbol_to_probe") or entry.get("canonical_guess")
+        num = int(err) if err.isdigit() else getattr(errno, err, None)
+        if not name or not num:
+            raise ValueError(f"bad chain step '{step}'")
+        steps.append(f"{name}:{num}" + (f"*{count}" if count else ""))
+    return ",".join(steps)
+
+
+def run_chain_campaign(ctx, fs_meta, symbol):
+    """
+    Each targeted task fails the chain's steps in order (e.g. openat ->
+    EMFILE, then its next close -> EIO) and then succeeds, exercising the
+    server's recovery path rather than a single isolated error.
+    """
+    try:
+        spec = chain_spec_for(fs_meta, find_opt("chain"))
+    except ValueError as e:
         print(f"[CTRL] ERROR: {e}", file=sys.stderr)
         sys.exit(1)
 
-    print(f"[CTRL] Detected server mode: {mode}")
+    duration = find_int_opt("duration", 10)
+    print(f"[CTRL] Chain mode: {spec} duration={duration}s")
+
+    try:
+        ctx.load_module(symbol, max_inj=1 << 30, extra={"chain_spec": spec})
+    except subprocess.CalledProcessError as e:
+        print(f"[CTRL] ERROR: insmod failed: {e}", file=sys.stderr)
+        sys.exit(1)
+
+    try:
+        time.sleep(duration)
+        print(f"[CTRL]  Chain faults injected: "
+              f"{read_param('injections_done')}")
+    finally:
+        ctx.finish()
+
+
+# ---- CORRELATED BURST ----
+
+def burst_spec_for(fs_meta, text):
+    """
+    Translate --burst=read,write:ENOSPC into the module's burst_spec
+    ("__x64_sys_read,__x64_sys_write:28"). Members name a catalogue syscall
+    or a raw kernel symbol; the errno is optional (EIO).
+    """
+    members = []
+    for member in text.split(","):
+        if not member:
+            continue
+        name, _, err = member.partition(":")
+        if name in fs_meta:
+            entry = fs_meta[name]
+            name = entry.get("symbol_to_probe") or entry.get("canonical_guess")
+        num = int(err) if err.isdigit() else getattr(errno, err, None) \
+            if err else errno.EIO
+        if not name or not num:
+            raise ValueError(f"bad burst member '{member}'")
+        members.append(f"{name}:{num}")
+    return ",".join(members)
+
+
+def run_burst_campaign(ctx, fs_meta, symbol):
+    """
+    Simulate a device outage: for --burst-ms every matched call to the
+    burst group fails at once (EIO, or each member's own errno), then the
+    window closes. Windows start --burst-at seconds after load and repeat
+    every --burst-period ms, --burst-count times. A launched server is told
+    where the window lives and prints a BURST line per window: throughput
+    before, during and after it, and how long recovery took.
+    """
+    try:
+        spec = burst_spec_for(fs_meta, find_opt("burst", ""))
+    except ValueError as e:
+        print(f"[CTRL] ERROR: {e}", file=sys.stderr)
+        sys.exit(1)
+
+    length = find_int_opt("burst-ms", 2000)
+    at = float(find_opt("burst-at", "5"))
+    period = find_int_opt("burst-period", 0)
+    count = find_int_opt("burst-count", 1)
+    if period and period < length:
+        print("[CTRL] ERROR: --burst-period must be at least --burst-ms",
+              file=sys.stderr)
+        sys.exit(1)
+    if count > 1 and not period:
+        print("[CTRL] ERROR: --burst-count > 1 needs --burst-period",
+              file=sys.stderr)
+        sys.exit(1)
+
+    window_param = os.path.join(SYSFS_BASE, "burst_window")
+    if ctx.launch:
+        ctx.server_args.append(f"--burst-window={window_param}")
+    else:
+        print(f"[CTRL] NOTE: start the server with --burst-window="
+              f"{window_param} to get its BURST lines")
+
+    print(f"[CTRL] Burst mode: group={spec or 'all hooked symbols'} "
+          f"len={length}ms at=+{at}s period={period or '-'}ms count={count}")
+
+    # No ordinary injections: only the windows fail calls
+    extra = {"burst_spec": spec} if spec else {}
+    try:
+        ctx.load_module(symbol, max_inj=0, extra=extra)
+    except subprocess.CalledProcessError as e:
+        print(f"[CTRL] ERROR: insmod failed: {e}", file=sys.stderr)
+        sys.exit(1)
+
+    try:
+        # CLOCK_MONOTONIC, the clock the module and the server use
+        start = time.monotonic_ns() + int(at * 1e9)
+        write_param("burst_window", f"{start},{length},{period}")
+        last_end = start + ((count - 1) * period + length) * 1000000
+        # one more window length, so the server reports the last window
+        time.sleep(max(0.0, (last_end - time.monotonic_ns()) / 1e9)
+                   + length / 1000.0 + 1.0)
+        write_param("burst_window", "")
+        print(f"[CTRL]  Burst injections: {read_param('burst_injections')}")
+    finally:
+        ctx.finish()
+
+
+# ---- OBSERVE-ONLY BASELINE ----
+
+def run_observe_campaign(ctx, symbol):
+    """
+    Inject nothing; count what the hooked symbols return on their own. The
+    histogram is saved with --baseline=FILE and scored by edi.py.
+    """
+    duration = find_int_opt("duration", 10)
+    print(f"[CTRL] Observe mode: duration={duration}s")
+
+    try:
+        ctx.load_module(symbol, extra={"fault_mode": 3})
+    except subprocess.CalledProcessError as e:
+        print(f"[CTRL] ERROR: insmod failed: {e}", file=sys.stderr)
+        sys.exit(1)
+
+    try:
+        time.sleep(duration)
+        for line in read_errors().splitlines():
+            if not line.startswith("#"):
+                print(f"[CTRL]  {line}")
+    finally:
+        ctx.finish()
+
+
+# ---- COVERAGE-GUIDED CAMPAIGN ----
+
+class KcovLog:
+    """
+    Incremental reader of the server's --kcov-log. Lines are
+    start_ns,total_edges,new_edges[,hash hash ...]: after the
+    "# baseline edges=N" line each iteration also lists, in hex, the
+    distinct edges it reached outside the warm-up set.
+    """
+
+    def __init__(self, path):
+        self.path = path
+        self.offset = 0
+        self.total = 0
+        self.baseline = None
+
+    def read(self):
+        """
+        Set of error-path edges of the iterations logged since last call.
+        """
+        edges = set()
+        try:
+            with open(self.path, "rb") as f:
+                f.seek(self.offset)
+                data = f.read()
+        except OSError:
+            return edges
+        end = data.rfind(b"\n") + 1        # a partial line waits
+        self.offset += end
+        for line in data[:end].splitlines():
+            if line.startswith(b"#"):
+                for tok in line[1:].split():
+                    if tok.startswith(b"edges="):
+                        self.baseline = int(tok[6:])
+                continue
+            fields = line.split(b",")
+            if len(fields) < 3:
+                continue
+            self.total = int(fields[1])
+            if len(fields) > 3:
+                edges.update(int(h, 16) for h in fields[3].split())
+        return edges
+
+
+def load_coverage_db(path):
+    try:
+        with open(path, "r") as f:
+            return json.load(f)
+    except (OSError, ValueError):
+        return {}
+
+
+def save_coverage_db(path, db):
+    tmp = path + ".tmp"
+    with open(tmp, "w") as f:
+        json.dump(db, f, indent=1, sort_keys=True)
+    os.replace(tmp, path)
+
+
+def variant_yield(stats):
+    """
+    Error-path edges a variant reached on its own per run. Variants never
+    tried go first, as do entries scored by first-come credit (no
+    own_edges): those counts are not comparable.
+    """
+    if not stats or not stats.get("runs") or "own_edges" not in stats:
+        return float("inf")
+    return stats["own_edges"] / stats["runs"]
+
+
+def run_coverage_campaign(ctx, entry, symbol):
+    """
+    Trace kernel coverage (kcov) around each server iteration and credit
+    (symbol, errno) with every edge outside the warm-up set that the
+    iterations reached while it was injected, whether or not another errno
+    reached it first. The queue is ordered by those per-variant yields in
+    the coverage DB (kept across runs), untried variants first. Within a
+    campaign, a variant whose --dwell round reached edges no round had is
+    queued again, ranked by that gain, up to --coverage-rounds rounds.
+    Variants that reached nothing outside the warm-up set in
+    --prune-after consecutive runs are skipped, and --coverage-target
+    stops the campaign early. The curve goes to --coverage-curve (CSV).
+    """
+    if not ctx.launch:
+        print("[CTRL] ERROR: --kcov needs --launch=MODE (the server must "
+              "start with --kcov-log)", file=sys.stderr)
+        sys.exit(1)
+
+    db_path = find_opt("coverage-db", os.path.join(ROOT_DIR, "coverage.json"))
+    curve_path = find_opt("coverage-curve", f"coverage_{ctx.mode}.csv")
+    dwell = float(find_opt("dwell", "2"))
+    warmup = find_int_opt("kcov-warmup", 3)
+    rounds = find_int_opt("coverage-rounds", 3)
+    prune_after = find_int_opt("prune-after", 3)
+    target = find_int_opt("coverage-target", 0)
+
+    kcov_log = os.path.join(SERVER_DIR, f"kcov_{ctx.mode}.csv")
+    if os.path.exists(kcov_log):
+        os.remove(kcov_log)
+    ctx.server_args += [f"--kcov-log={kcov_log}",
+                        f"--kcov-baseline={warmup}"]
+    kcov = KcovLog(kcov_log)
+
+    db = load_coverage_db(db_path)
+    sym_db = db.setdefault(symbol, {})
+    variants = [ev for ev in entry.get("error_variants") or []
+                if (ev.get("errno_num") or 0) > 0]
+    # (expected new edges, variant)
+    queue = [(variant_yield(sym_db.get(ev["errno_name"])), ev)
+             for ev in variants]
+
+    print(f"[CTRL] Coverage mode: {len(queue)} variants, dwell={dwell}s "
+          f"rounds={rounds} prune_after={prune_after} "
+          f"target={target or 'none'}")
+
+    # No injection budget during warm-up: its edges are the workload's own
+    try:
+        ctx.load_module(symbol, max_inj=0)
+    except subprocess.CalledProcessError as e:
+        print(f"[CTRL] ERROR: insmod failed: {e}", file=sys.stderr)
+        sys.exit(1)
+
+    t_start = time.time()
+    covered = set()     # error-path edges reached in this campaign
+    own = {}            # errno name -> edges its rounds reached
+    nrounds = {}
+    ran = pruned = 0
+    try:
+        deadline = time.time() + warmup + 30
+        while kcov.baseline is None:
+            if time.time() > deadline or ctx.exit_state() != "running":
+                print("[CTRL] ERROR: the server never froze its kcov "
+                      "baseline", file=sys.stderr)
+                return
+            time.sleep(0.2)
+            kcov.read()
+        print(f"[CTRL]  Warm-up edges: {kcov.baseline}")
+        write_param("inject_errno", 0)      # 0 = off between variants
+        write_param("max_injections", 1 << 30)
+
+        with open(curve_path, "w") as curve:
+            curve.write("elapsed_s,symbol,errno,own_edges,new_edges,"
+                        "error_edges,total_edges\n")
+            while queue:
+                queue.sort(key=lambda q: -q[0])
+                _, ev = queue.pop(0)
+                name, num = ev["errno_name"], ev["errno_num"]
+                stats = sym_db.get(name) or {}
+                if ("own_edges" in stats and name not in own and
+                        stats["zero_runs"] >= prune_after):
+                    pruned += 1
+                    print(f"[CTRL]  Pruned {name}: no edges of its own in "
+                          f"{stats['zero_runs']} runs")
+                    continue
+
+                kcov.read()                 # the gap belongs to no errno
+                write_param("inject_errno", num)
+                time.sleep(dwell)
+                write_param("inject_errno", 0)
+                edges = kcov.read()
+
+                new = edges - covered
+                covered |= new
+                own.setdefault(name, set()).update(edges)
+                nrounds[name] = nrounds.get(name, 0) + 1
+                ran += 1
+                curve.write(f"{time.time() - t_start:.3f},{symbol},{name},"
+                            f"{len(edges)},{len(new)},{len(covered)},"
+                            f"{kcov.total}\n")
+                curve.flush()
+                print(f"[CTRL]  {name}({num}): {len(edges)} edges, "
+                      f"+{len(new)} new (error-path total {len(covered)})")
+
+                if target and len(covered) >= target:
+                    print(f"[CTRL]  Coverage target {target} reached after "
+                          f"{ran} rounds")
+                    break
+                # still reaching edges no round had: worth another round
+                if new and nrounds[name] < rounds:
+                    queue.append((len(new), ev))
+    finally:
+        for name, edges in own.items():
+            stats = sym_db.get(name)
+            if not stats or "own_edges" not in stats:
+                stats = sym_db[name] = {"runs": 0, "own_edges": 0,
+                                        "zero_runs": 0}
+            stats["runs"] += 1
+            stats["own_edges"] += len(edges)
+            stats["zero_runs"] = 0 if edges else stats["zero_runs"] + 1
+        save_coverage_db(db_path, db)
+        print(f"[CTRL] Coverage: rounds={ran} pruned={pruned} "
+              f"skipped={len(variants) - len(own) - pruned} "
+              f"curve={curve_path} db={db_path}")
+        ctx.finish()
+
+
+# ---- ERRNO DISCOVERY ----
+
+def run_discovery(target):
+    """
+    Run the server's scenarios in perturbed sandboxes (missing paths, RO
+    files, fd exhaustion, long names, loops, full / read-only fs, ...) and
+    write the errnos each one actually produced back to the catalogue.
+    No module is loaded. --discover-keep lists errnos that are kept even
+    if unobserved (default EIO,ENOMEM); --dry-run only prints the result.
+    """
+    out_path = find_opt("discover-out",
+                        os.path.join(SERVER_DIR, "discover.txt"))
+    args = [SERVER_PATH,
+            "--discover" if target == "all" else f"--discover={target}",
+            f"--discover-out={out_path}"]
+    print(f"[CTRL] discover: {' '.join(args)}")
+    subprocess.run(args, cwd=SERVER_DIR, check=True,
+                   stdout=subprocess.DEVNULL)
+
+    observed, exercised = {}, set()
+    with open(out_path, "r") as f:
+        for line in f:
+            mode, perturb, result = line.split()
+            nums = observed.setdefault(mode, set())
+            if result in ("unexercised", "timeout"):
+                continue
+            exercised.add(mode)
+            if result != "-":
+                nums.update(int(n) for n in result.split(","))
+                print(f"[CTRL]  {mode:<18} {perturb:<14} {result}")
+
+    keep = [n for n in find_opt("discover-keep", "EIO,ENOMEM").split(",")
+            if n]
+    observed = {m: nums for m, nums in observed.items() if m in exercised}
+    write = "--dry-run" not in sys.argv[1:]
+    changes = apply_discovery(observed, keep=keep, write=write)
+    for mode, (before, after) in sorted(changes.items()):
+        print(f"[CTRL] {mode}: {len(before)} -> {len(after)} errnos "
+              f"({','.join(after) or 'none'})")
+    if write:
+        print(f"[CTRL] Updated {CATALOGUE_PATH}")
+
+
+# ---- MAIN CONTROL FLOW ----
+
+def resolve_path_prefix(pid):
+    """
+    --path-prefix=P1,P2 or --path-prefix=auto (the server's sandbox: its
+    cwd when attached, server/fs_sandbox when launched).
+    """
+    value = find_opt("path-prefix")
+    if value != "auto":
+        return value
+    if pid:
+        return os.readlink(f"/proc/{pid}/cwd")
+    return os.path.join(SERVER_DIR, "fs_sandbox")
+
+
+def resolve_callsite():
+    """
+    --callsite-depth=N fingerprints call sites (hit table only);
+    --callsite=FP[,FP] also restricts injection to those sites.
+    """
+    fps = find_opt("callsite")
+    depth = find_int_opt("callsite-depth", 4 if fps else 0)
+    if depth <= 0:
+        return None
+    return depth, fps
+
+
+def server_args():
+    """
+    Extra server arguments for launched servers: --server-args="..."
+    """
+    return (find_opt("server-args") or "").split()
+
+
+def exit_on_sigterm(signum, frame):
+    """
+    SIGTERM (e.g. from timeout(1)) unwinds like Ctrl-C: the finally blocks
+    unload the module and close the journal.
+    """
+    sys.exit(128 + signum)
+
+
+def main():
+    signal.signal(signal.SIGTERM, exit_on_sigterm)
+    replay_path = find_opt("replay")
+    if replay_path:
+        run_replay(replay_path)
+        return
+
+    discover = find_opt("discover", "all" if "--discover" in sys.argv[1:]
+                        else None)
+    if discover:
+        run_discovery(discover)
+        return
+
+    # 1) Find server PID, or launch one ourselves (--launch=MODE), or
+    #    target whole cgroups (--cgroup=PATH[,PATH] --mode=NAME), or observe
+    #    every task (--system-wide --mode=NAME --fault=observe)
+    launch_mode = find_opt("launch")
+    system_wide = "--system-wide" in sys.argv[1:]
+    if system_wide and find_opt("fault") != "observe":
+        print("[CTRL] ERROR: --system-wide is only allowed with "
+              "--fault=observe", file=sys.stderr)
+        sys.exit(1)
+    cgroup_paths = find_opt("cgroup")
+    cgroups = None
+    pid = None
+    if cgroup_paths:
+        try:
+            cgroups = cgroup_ids(cgroup_paths)
+        except OSError as e:
+            print(f"[CTRL] ERROR: bad --cgroup: {e}", file=sys.stderr)
+            sys.exit(1)
+        print(f"[CTRL] Targeting cgroup ids: {cgroups}")
+
+    if launch_mode:
+        mode = launch_mode
+        print(f"[CTRL] Will launch server in mode: {mode}")
+    elif cgroups or system_wide:
+        mode = find_opt("mode")
+        if not mode:
+            print("[CTRL] ERROR: --cgroup/--system-wide need --mode=NAME "
+                  "(or --launch)", file=sys.stderr)
+            sys.exit(1)
+    else:
+        pid = find_server_pid_explicit()
+        if pid is None:
+            pid = find_server_pid_auto()
+
+        if pid is None:
+            print("[CTRL] ERROR: No running 'server' process found. "
+                  "Start './server --mode=...' first.", file=sys.stderr)
+            sys.exit(1)
+
+        print(f"[CTRL] Using server PID: {pid}")
+
+        # 2) Detect mode from /proc/<pid>/cmdline
+        try:
+            mode = read_server_mode_from_cmdline(pid)
+        except RuntimeError as e:
+            print(f"[CTRL] ERROR: {e}", file=sys.stderr)
+            sys.exit(1)
+
+        print(f"[CTRL] Detected server mode: {mode}")
 
     # 3) Load FS syscall metadata and find matching entry
     fs_meta = load_fs_metadata()
 
     if mode not in fs_meta:
         print(f"[CTRL] ERROR: No metadata entry for syscall '{mode}' "
-              f"in {JSON_PATH}", file=sys.stderr)
+              f"in {CATALOGUE_PATH}", file=sys.stderr)
         sys.exit(1)
 
     entry = fs_meta[mode]
     symbol = entry.get("symbol_to_probe") or entry.get("canonical_guess")
+    # --symbol= overrides the catalogue; a comma list hooks several symbols
+    symbol = find_opt("symbol", symbol)
+    # --probe= hooks internal kernel paths instead (filemap, writeback)
+    if find_opt("probe"):
+        symbol = internal_probes(entry, find_opt("probe"))
     if not symbol:
         print(f"[CTRL] ERROR: No symbol_to_probe/canonical_guess for '{mode}'",
               file=sys.stderr)
         sys.exit(1)
 
+    every = find_int_opt("every", 1)
+    if every < 1:
+        print("[CTRL] ERROR: --every must be >= 1", file=sys.stderr)
+        sys.exit(1)
+
+    prefixes = resolve_path_prefix(pid)
+    if prefixes:
+        print(f"[CTRL] Path-prefix filter: {prefixes}")
+
+    callsite = resolve_callsite()
+    if callsite:
+        print(f"[CTRL] Call-site fingerprints: depth={callsite[0]} "
+              f"targets={callsite[1] or 'all'}")
+
+    ctx = Campaign(mode, pid=pid, launch=bool(launch_mode), every=every,
+                   record_path=find_opt("record"), server_args=server_args(),
+                   path_filter=(prefixes, fs_meta) if prefixes else None,
+                   cgroups=cgroups, callsite=callsite,
+                   baseline_path=find_opt("baseline"))
+    # launched server's stdout (RECOVERY lines for ttr.py, etc.)
+    if launch_mode:
+        ctx.log_path = find_opt("server-log")
+
+    if find_opt("chain"):
+        print(f"[CTRL] Will hook kernel symbol(s): {symbol} + chain symbols")
+        run_chain_campaign(ctx, fs_meta, symbol)
+        return
+
+    fault = find_opt("fault", "errno")
+    if fault == "errno" and "--kcov" in sys.argv[1:]:
+        print(f"[CTRL] Will hook kernel symbol: {symbol}")
+        run_coverage_campaign(ctx, entry, symbol)
+        return
+    if fault == "observe":
+        print(f"[CTRL] Will hook kernel symbol(s): {symbol}")
+        run_observe_campaign(ctx, symbol)
+        return
+    if fault == "short":
+        print(f"[CTRL] Will hook kernel symbol: {symbol}")
+        run_short_campaign(ctx, entry, symbol)
+        return
+    if fault == "delay":
+        print(f"[CTRL] Will hook kernel symbol(s): {symbol}")
+        run_delay_campaign(ctx, symbol)
+        return
+    if fault == "burst":
+        print(f"[CTRL] Will hook kernel symbol(s): {symbol} + burst group")
+        run_burst_campaign(ctx, fs_meta, symbol)
+        return
+    if fault != "errno":
+        print(f"[CTRL] ERROR: unknown --fault={fault} "
+              f"(errno|short|delay|observe|burst)",
+              file=sys.stderr)
+        sys.exit(1)
+
     variants = entry.get("error_variants") or []
+    # --errno=NAME[,NAME] runs only those variants (one job per guest in
+    # vm/qemu_runner.py)
+    only = find_opt("errno")
+    if only:
+        variants = [ev for ev in variants
+                    if ev.get("errno_name") in only.split(",")]
     if not variants:
         print(f"[CTRL] WARNING: No error_variants for '{mode}', nothing to do.")
         sys.exit(0)
@@ -195,13 +1299,44 @@ def main():
     print(f"[CTRL] Syscall '{mode}' has {len(variants)} error variants.")
     print(f"[CTRL] Will hook kernel symbol: {symbol}")
 
+    # Outcome fingerprints: skip variants predicted to repeat a known
+    # outcome (--sample-repeats=P still runs a fraction, --verify runs all)
+    outcomes = None
+    if "--fingerprint" in sys.argv[1:]:
+        if not launch_mode:
+            print("[CTRL] ERROR: --fingerprint needs --launch=MODE (the "
+                  "server's output is captured)", file=sys.stderr)
+            sys.exit(1)
+        cache = OutcomeCache(find_opt("outcome-cache", os.path.join(
+            ROOT_DIR, "outcome_cache.json")))
+        outcomes = OutcomeRun(cache, syscall_class(entry), mode,
+                              sample=float(find_opt("sample-repeats", "0")),
+                              verify="--verify" in sys.argv[1:])
+        ctx.log_path = find_opt("server-log", os.path.join(
+            SERVER_DIR, f"server_{mode}.log"))
+        settle = float(find_opt("settle", "1"))
+        print(f"[CTRL] Fingerprinting outcomes: class={outcomes.cls} "
+              f"cache={cache.path}")
+
     # 4) Load kernel module for this symbol + PID
     try:
-        insmod_module(symbol, pid, max_inj=1000, unsafe=1)
+        ctx.load_module(symbol, max_inj=1000, unsafe=1)
     except subprocess.CalledProcessError as e:
         print(f"[CTRL] ERROR: insmod failed: {e}", file=sys.stderr)
         sys.exit(1)
 
+    # Resumable sweep: completed variants are skipped on restart
+    journal = None
+    if "--no-journal" not in sys.argv[1:]:
+        journal_path = find_opt("journal", os.path.join(
+            ROOT_DIR, f"journal_{mode}.jsonl"))
+        if "--fresh" in sys.argv[1:] and os.path.exists(journal_path):
+            os.remove(journal_path)
+        journal = Journal(journal_path, mode)
+        if journal.done:
+            print(f"[CTRL] Journal {journal_path}: resuming, "
+                  f"{len(journal.done)} variants already done")
+
     # 5) Iterate over error variants
     try:
         for idx, ev in enumerate(variants):
@@ -214,8 +1349,26 @@ def main():
             print(f"[CTRL]  Variant {idx+1}/{len(variants)}: "
                   f"{errno_name}({errno_num})")
 
+            if journal and errno_name in journal.done:
+                print(f"[CTRL]  Already done: {journal.done[errno_name]}")
+                continue
+
+            if outcomes:
+                predicted = outcomes.should_skip(errno_name)
+                if predicted:
+                    print(f"[CTRL]  Skipped: predicted repeat of outcome "
+                          f"{predicted}")
+                    if journal:
+                        journal.finish(errno_name, f"predicted:{predicted}")
+                    continue
+                offset = ctx.output_offset()
+
+            if journal:
+                journal.start(errno_name)
+
             try:
                 prev = read_param("injections_done")
+                prev_rejects = read_param("errno_rejects")
             except FileNotFoundError:
                 print("[CTRL]  ERROR: injections_done not available; "
                       "module not loaded?", file=sys.stderr)
@@ -225,16 +1378,46 @@ def main():
             write_param("inject_errno", errno_num)
 
             ok = wait_for_injection(prev, timeout_sec=10.0)
+            if not ok and read_param("errno_rejects") > prev_rejects:
+                print(f"[CTRL]  WARNING: errno={errno_num} is not in the "
+                      f"symbol's errno allowlist")
+                if journal:
+                    journal.finish(errno_name, "rejected")
+                continue
             if not ok:
                 print(f"[CTRL]  WARNING: timeout waiting for injection "
                       f"for errno={errno_num}")
+                if journal:
+                    journal.finish(errno_name, "timeout")
                 continue
 
             print(f"[CTRL]  Injection observed for errno={errno_num}")
+            result = "injected"
+
+            if outcomes:
+                time.sleep(settle)
+                fp, outcome = outcomes.record(
+                    errno_name, errno_num, ctx.output_since(offset),
+                    read_param("injections_done") - prev, ctx.exit_state())
+                print(f"[CTRL]  Outcome {fp}: seq={','.join(outcome['seq'])} "
+                      f"cascade={outcome['cascade']} exit={outcome['exit']}")
+                result = fp
+                if outcome["exit"] != "running":
+                    if journal:
+                        journal.finish(errno_name, f"server-{outcome['exit']}")
+                    print("[CTRL]  Server is gone; stopping the sweep")
+                    break
+
+            if journal:
+                journal.finish(errno_name, result)
     finally:
-        # 6) Always unload module at end
-        rmmod_module()
-        print("[CTRL] Done. Module unloaded.")
+        # 6) Always unload module at end (saving the schedule if recording)
+        if journal:
+            journal.close()
+        if outcomes:
+            outcomes.cache.save()
+            print(f"[CTRL] {outcomes.summary()}")
+        ctx.finish()
 
 
 if __name__ == "__main__":
@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""
+Score the realism of each catalogued errno against a natural-error baseline.
+
+The baseline is the injector's debugfs fs_injector/errors table, saved by
+`controller.py --fault=observe --baseline=FILE` (or --baseline with any other
+fault mode, which counts the returns before they are overridden):
+
+    __x64_sys_openat calls=1200 success=1100 2:90 13:10
+
+For every error variant of every catalogue entry hooked in the baseline the
+Error Distortion Index is
+
+    EDI = log(calls / count) / log(calls)     (1.0 if count == 0)
+
+i.e. how surprising the errno is on a log scale relative to the sample:
+0.0 when every call naturally fails that way, 1.0 when it was never seen.
+
+Usage: ./edi.py BASELINE [--mode=NAME] [--max-edi=X]
+"""
+import math
+import sys
+
+from controller import find_opt, load_fs_metadata
+
+
+def parse_baseline(path):
+    """
+    Return (header dict, {symbol: (calls, success, {errno: count})}).
+    """
+    header, table = {}, {}
+    with open(path, "r") as f:
+        for line in f:
+            line = line.strip()
+            if not line:
+                continue
+            if line.startswith("#"):
+                for kv in line[1:].split():
+                    key, _, value = kv.partition("=")
+                    header[key] = value
+                continue
+            symbol, *fields = line.split()
+            calls = success = 0
+            errs = {}
+            for field in fields:
+                if field.startswith("calls="):
+                    calls = int(field[6:])
+                elif field.startswith("success="):
+                    success = int(field[8:])
+                else:
+                    err, _, count = field.partition(":")
+                    if err != "other":
+                        errs[int(err)] = int(count)
+            table[symbol] = (calls, success, errs)
+    return header, table
+
+
+def edi(calls, count):
+    if count <= 0 or calls < 2:
+        return 1.0
+    return math.log(calls / count) / math.log(calls)
+
+
+def main():
+    if len(sys.argv) < 2 or sys.argv[1].startswith("--"):
+        print(__doc__.strip().splitlines()[-1], file=sys.stderr)
+        sys.exit(1)
+
+    header, table = parse_baseline(sys.argv[1])
+    mode = find_opt("mode", header.get("mode"))
+    max_edi = float(find_opt("max-edi", "1.0"))
+    fs_meta = load_fs_metadata()
+
+    entries = [fs_meta[mode]] if mode in fs_meta else fs_meta.values()
+    for entry in entries:
+        symbol = entry.get("symbol_to_probe") or entry.get("canonical_guess")
+        if symbol not in table:
+            continue
+        calls, success, errs = table[symbol]
+        print(f"[EDI] {entry['name']} ({symbol}): calls={calls} "
+              f"success={success}")
+        for ev in entry.get("error_variants") or []:
+            num = ev.get("errno_num")
+            count = errs.get(num, 0)
+            score = edi(calls, count)
+            if score > max_edi:
+                continue
+            rate = count / calls if calls else 0.0
+            print(f"[EDI]  {ev.get('errno_name'):<16} natural={count:<8} "
+                  f"rate={rate:.6f} EDI={score:.3f}")
+
+        # errnos seen in the wild that the catalogue does not list
+        listed = {ev.get("errno_num") for ev in entry.get("error_variants")
+                  or []}
+        for num in sorted(set(errs) - listed):
+            print(f"[EDI]  errno {num} occurs naturally ({errs[num]}x) "
+                  f"but is not catalogued")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,227 @@
+#!/usr/bin/env python3
+"""
+Run one (syscall, errno) campaign on several filesystem types and compare.
+
+For every filesystem type a fresh loopback image is made and mounted (tmpfs
+is mounted directly), and the server is launched with its sandbox on that
+mount. Each filesystem then goes through the same phases, --duration
+seconds each:
+
+    base       no module loaded
+    probe      module loaded in observe mode: kretprobe cost, no faults
+    <ERRNO>    every call to the syscall fails with that errno
+
+The latency of each phase is the server's LATENCY scope=total line. The
+cascade is its CASCADE line: FAIL lines per iteration that failed.
+Injection overhead is probe minus base. The matrix is printed with one
+column per filesystem and saved as JSON:
+
+    {"mode": "openat", "fstypes": ["ext4", ...],
+     "results": {"ext4": {"base": {"p50_us": 3.1, ...}, "EIO": {...}}}}
+
+Usage: ./fs_matrix.py --mode=NAME [--fstypes=ext4,xfs,btrfs,tmpfs]
+         [--errnos=EIO,ENOSPC] [--image-size=512M] [--duration=10]
+         [--workdir=DIR] [--out=FILE] [--symbol=SYM] [--server-args="..."]
+"""
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+import time
+
+from controller import (ROOT_DIR, Campaign, find_int_opt, find_opt,
+                        load_fs_metadata, read_param, rmmod_module,
+                        server_args)
+
+FSTYPES = ("ext4", "xfs", "btrfs", "tmpfs")
+MKFS = {
+    "ext4":  ["mkfs.ext4", "-q", "-F"],
+    "xfs":   ["mkfs.xfs", "-q", "-f"],
+    "btrfs": ["mkfs.btrfs", "-q", "-f"],
+}
+
+LATENCY_RE = re.compile(r"\[SERVER\] \S+ LATENCY scope=total n=(\d+) "
+                        r"mean_us=([\d.]+) p50_us=([\d.]+) p90_us=[\d.]+ "
+                        r"p99_us=([\d.]+)")
+CASCADE_RE = re.compile(r"\[SERVER\] \S+ CASCADE iters=(\d+) "
+                        r"fail_iters=(\d+) fails=(\d+) max_cascade=(\d+)")
+
+
+def run(args):
+    subprocess.run(args, check=True, stdout=subprocess.DEVNULL,
+                   stderr=subprocess.DEVNULL)
+
+
+def mount_fs(fstype, workdir, size):
+    """
+    Make and mount a filesystem of fstype under workdir. Returns the mount
+    point, or None if the tools for it are missing.
+    """
+    mnt = os.path.join(workdir, fstype)
+    os.makedirs(mnt, exist_ok=True)
+    subprocess.run(["umount", mnt], stderr=subprocess.DEVNULL)
+    if fstype == "tmpfs":
+        run(["mount", "-t", "tmpfs", "-o", f"size={size}", "tmpfs", mnt])
+        return mnt
+    if not shutil.which(MKFS[fstype][0]):
+        return None
+    image = os.path.join(workdir, f"{fstype}.img")
+    if os.path.exists(image):
+        os.remove(image)
+    run(["truncate", "-s", size, image])
+    run(MKFS[fstype] + [image])
+    run(["mount", "-o", "loop", image, mnt])
+    return mnt
+
+
+def umount_fs(fstype, workdir):
+    mnt = os.path.join(workdir, fstype)
+    subprocess.run(["umount", mnt], stderr=subprocess.DEVNULL)
+    image = os.path.join(workdir, f"{fstype}.img")
+    if os.path.exists(image):
+        os.remove(image)
+
+
+def parse_phase(lines):
+    stats = {}
+    for line in lines:
+        m = LATENCY_RE.search(line)
+        if m:
+            stats.update(n=int(m.group(1)), mean_us=float(m.group(2)),
+                         p50_us=float(m.group(3)), p99_us=float(m.group(4)))
+        m = CASCADE_RE.search(line)
+        if m:
+            iters, fail_iters, fails, worst = map(int, m.groups())
+            stats.update(fail_iters=fail_iters, max_cascade=worst,
+                         cascade=round(fails / fail_iters, 2)
+                         if fail_iters else 0.0)
+    return stats
+
+
+def run_phase(ctx, symbol, duration, extra=None):
+    """
+    One server run: without the module when extra is None, else with it
+    loaded using extra. Returns the parsed LATENCY/CASCADE numbers.
+    """
+    rmmod_module()
+    if extra is None:
+        ctx.start_server()
+    else:
+        ctx.load_module(symbol, max_inj=1 << 30, extra=extra)
+    time.sleep(duration)
+    injections = read_param("injections_done") if extra else 0
+    ctx.stop_server()
+    rmmod_module()
+    stats = parse_phase(ctx.output_since(0))
+    stats["injections"] = injections
+    return stats
+
+
+def print_matrix(mode, fstypes, results, phases):
+    width = 12
+    rows = [
+        ("p50_us", "p50 latency (us)"),
+        ("p99_us", "p99 latency (us)"),
+        ("cascade", "cascade (FAIL lines per failing iteration)"),
+    ]
+    head = "".join(f"{fs:>{width}}" for fs in fstypes)
+    for key, title in rows:
+        print(f"[MATRIX] {mode}: {title}")
+        print(f"[MATRIX]   {'':<12}{head}")
+        for phase in phases:
+            if key == "cascade" and phase in ("base", "probe"):
+                continue
+            cells = ""
+            for fs in fstypes:
+                v = results.get(fs, {}).get(phase, {}).get(key)
+                cells += f"{v:>{width}.1f}" if v is not None \
+                    else f"{'-':>{width}}"
+            print(f"[MATRIX]   {phase:<12}{cells}")
+    print(f"[MATRIX] {mode}: injection overhead, probe - base p50 (us)")
+    print(f"[MATRIX]   {'':<12}{head}")
+    cells = ""
+    for fs in fstypes:
+        r = results.get(fs, {})
+        if "p50_us" in r.get("probe", {}) and "p50_us" in r.get("base", {}):
+            cells += f"{r['probe']['p50_us'] - r['base']['p50_us']:>{width}.1f}"
+        else:
+            cells += f"{'-':>{width}}"
+    print(f"[MATRIX]   {'overhead':<12}{cells}")
+
+
+def main():
+    mode = find_opt("mode")
+    fs_meta = load_fs_metadata()
+    if not mode or mode not in fs_meta:
+        print(__doc__.strip().split("Usage: ")[-1], file=sys.stderr)
+        sys.exit(1)
+    entry = fs_meta[mode]
+    symbol = find_opt("symbol", entry.get("canonical_guess"))
+
+    fstypes = find_opt("fstypes", ",".join(FSTYPES)).split(",")
+    for fs in fstypes:
+        if fs not in FSTYPES:
+            print(f"[MATRIX] ERROR: unsupported filesystem '{fs}'",
+                  file=sys.stderr)
+            sys.exit(1)
+    variants = {ev["errno_name"]: ev["errno_num"]
+                for ev in entry.get("error_variants") or []}
+    errnos = find_opt("errnos", "EIO").split(",")
+    for name in errnos:
+        if name not in variants:
+            print(f"[MATRIX] ERROR: {name} is not an error variant of "
+                  f"'{mode}'", file=sys.stderr)
+            sys.exit(1)
+
+    duration = find_int_opt("duration", 10)
+    size = find_opt("image-size", "512M")
+    workdir = os.path.abspath(find_opt("workdir",
+                                       os.path.join(ROOT_DIR, "fs_matrix")))
+    out_path = find_opt("out", os.path.join(workdir, f"matrix_{mode}.json"))
+    os.makedirs(workdir, exist_ok=True)
+
+    phases = ["base", "probe"] + errnos
+    results = {}
+    for fs in fstypes:
+        try:
+            mnt = mount_fs(fs, workdir, size)
+        except subprocess.CalledProcessError as e:
+            print(f"[MATRIX] {fs}: setup failed ({e}), skipped")
+            continue
+        if mnt is None:
+            print(f"[MATRIX] {fs}: {MKFS[fs][0]} not found, skipped")
+            continue
+
+        print(f"[MATRIX] {fs}: sandbox on {mnt}")
+        ctx = Campaign(mode, launch=True, server_args=server_args() + [
+            f"--sandbox={os.path.join(mnt, 'fs_sandbox')}"])
+        ctx.log_path = os.path.join(workdir, f"server_{fs}.log")
+        results[fs] = {}
+        try:
+            results[fs]["base"] = run_phase(ctx, symbol, duration)
+            results[fs]["probe"] = run_phase(ctx, symbol, duration,
+                                             {"fault_mode": 3})
+            for name in errnos:
+                results[fs][name] = run_phase(
+                    ctx, symbol, duration, {"inject_errno": variants[name]})
+                print(f"[MATRIX] {fs}: {name} "
+                      f"{json.dumps(results[fs][name])}")
+        except subprocess.CalledProcessError as e:
+            print(f"[MATRIX] {fs}: insmod failed ({e})", file=sys.stderr)
+        finally:
+            ctx.stop_server()
+            rmmod_module()
+            if "--keep" not in sys.argv[1:]:
+                umount_fs(fs, workdir)
+
+    print_matrix(mode, fstypes, results, phases)
+    with open(out_path, "w") as f:
+        json.dump({"mode": mode, "symbol": symbol, "fstypes": fstypes,
+                   "duration": duration, "results": results}, f, indent=1)
+    print(f"[MATRIX] Saved {out_path}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+"""
+Export injector and server counters as a Prometheus text file.
+
+Sources, both read without touching the hot paths:
+
+  - the injector's debugfs fs_injector/metrics (per-CPU counters summed on
+    read): injections, filter rejects, kretprobe misses, natural returns
+    and injections per symbol and errno
+  - the server's --metrics-shm mapping (relaxed atomic counters):
+    iterations, failing iterations, FAIL lines per errno, SIGBUS count and
+    a latency histogram
+
+Every --interval seconds the combined text is written to OUT.tmp and
+renamed over OUT, so a collector (node_exporter's textfile collector,
+`watch cat`, ...) never reads a partial file. Numeric errno labels are
+replaced by their names.
+
+Usage: ./metrics.py --out=FILE [--shm=FILE[,FILE]] [--interval=5] [--once]
+"""
+import errno
+import mmap
+import os
+import re
+import struct
+import sys
+import time
+
+from controller import DEBUGFS_BASE, find_int_opt, find_opt
+
+SHM_MAGIC = b"FSMETRIC"
+SHM_VERSION = 1
+SHM_HEADER = struct.Struct("<8sII32s")
+SHM_ERRNOS = 134
+SHM_BUCKETS = 8
+SHM_COUNTERS = struct.Struct(f"<5Q{SHM_BUCKETS}Q{SHM_ERRNOS}Q")
+BUCKET_LE = ["1e-06", "1e-05", "0.0001", "0.001", "0.01", "0.1", "1", "+Inf"]
+
+ERRNO_LABEL_RE = re.compile(r'errno="(\d+)"')
+
+
+def errno_label(m):
+    num = int(m.group(1))
+    name = "0" if num == 0 else errno.errorcode.get(num, str(num))
+    return f'errno="{name}"'
+
+
+def injector_metrics():
+    try:
+        with open(os.path.join(DEBUGFS_BASE, "metrics"), "r") as f:
+            text = f.read()
+    except OSError:
+        return "# fs_injector not loaded\n"
+    return ERRNO_LABEL_RE.sub(errno_label, text)
+
+
+def server_metrics(path):
+    """
+    Prometheus lines for one server's --metrics-shm file, or [] if it is
+    missing or not (yet) initialised.
+    """
+    try:
+        with open(path, "rb") as f:
+            buf = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    except (OSError, ValueError):
+        return []
+    try:
+        magic, version, pid, mode = SHM_HEADER.unpack_from(buf, 0)
+        if magic != SHM_MAGIC or version != SHM_VERSION:
+            return []
+        vals = SHM_COUNTERS.unpack_from(buf, SHM_HEADER.size)
+    finally:
+        buf.close()
+
+    iterations, fail_iters, fails, sigbus, lat_sum_ns = vals[:5]
+    buckets = vals[5:5 + SHM_BUCKETS]
+    by_errno = vals[5 + SHM_BUCKETS:]
+    mode = mode.rstrip(b"\0").decode(errors="replace")
+    up = 1 if os.path.exists(f"/proc/{pid}") else 0
+    lbl = f'mode="{mode}",pid="{pid}"'
+
+    out = [f"fs_server_up{{{lbl}}} {up}",
+           f"fs_server_iterations_total{{{lbl}}} {iterations}",
+           f"fs_server_fail_iterations_total{{{lbl}}} {fail_iters}",
+           f"fs_server_failures_total{{{lbl}}} {fails}",
+           f"fs_server_sigbus_total{{{lbl}}} {sigbus}"]
+    for num, n in enumerate(by_errno):
+        if n:
+            name = errno.errorcode.get(num, str(num))
+            out.append(f'fs_server_failures_by_errno_total{{{lbl},'
+                       f'errno="{name}"}} {n}')
+    cum = 0
+    for le, n in zip(BUCKET_LE, buckets):
+        cum += n
+        out.append(f'fs_server_latency_seconds_bucket{{{lbl},le="{le}"}} '
+                   f'{cum}')
+    out.append(f"fs_server_latency_seconds_sum{{{lbl}}} {lat_sum_ns / 1e9}")
+    out.append(f"fs_server_latency_seconds_count{{{lbl}}} {iterations}")
+    return out
+
+
+SERVER_TYPES = [
+    ("fs_server_up", "gauge"),
+    ("fs_server_iterations_total", "counter"),
+    ("fs_server_fail_iterations_total", "counter"),
+    ("fs_server_failures_total", "counter"),
+    ("fs_server_sigbus_total", "counter"),
+    ("fs_server_failures_by_errno_total", "counter"),
+    ("fs_server_latency_seconds", "histogram"),
+]
+
+
+def render(shm_paths):
+    samples = []
+    for path in shm_paths:
+        samples += server_metrics(path)
+    # the exposition format wants each family's samples together
+    text = ""
+    for name, kind in SERVER_TYPES:
+        names = (name, name + "_bucket", name + "_sum", name + "_count")
+        family = [s for s in samples if s.split("{")[0] in names]
+        if family:
+            text += f"# TYPE {name} {kind}\n" + "\n".join(family) + "\n"
+    return injector_metrics() + text
+
+
+def write_atomic(path, text):
+    tmp = path + ".tmp"
+    with open(tmp, "w") as f:
+        f.write(text)
+    os.replace(tmp, path)
+
+
+def main():
+    out = find_opt("out")
+    if not out:
+        print(__doc__.strip().splitlines()[-1], file=sys.stderr)
+        sys.exit(1)
+    shm = [p for p in (find_opt("shm") or "").split(",") if p]
+    interval = find_int_opt("interval", 5)
+
+    while True:
+        write_atomic(out, render(shm))
+        if "--once" in sys.argv[1:]:
+            return
+        time.sleep(interval)
+
+
+if __name__ == "__main__":
+    try:
+        main()
+    except KeyboardInterrupt:
+        pass
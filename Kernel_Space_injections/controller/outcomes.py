@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""
+Outcome fingerprints for errno variants.
+
+A variant's outcome is what the server did while it was injected: the
+sequence of failing scenarios (the injected errno normalised to "E", so an
+identical reaction to EIO and to ENOMEM matches), the cascade length (FAIL
+lines per injection) and the server's exit state. Fingerprints are cached
+per syscall class (path, path-at, fd, other) and errno, so a cache built on
+one machine predicts outcomes on another:
+
+    {"version": 1,
+     "classes":  {"path": {"EIO": {"3f2a9c0d11e4": 4}}},
+     "outcomes": {"3f2a9c0d11e4": {"seq": ["self:E"], "cascade": 1,
+                                   "exit": "running"}}}
+
+Usage: ./outcomes.py --merge OUT IN [IN...]   (combine caches)
+"""
+import hashlib
+import json
+import os
+import random
+import re
+import sys
+
+FAIL_RE = re.compile(r"\[SERVER\] (\S+) FAIL ret=-?\d+ errno=(\d+)")
+
+
+def syscall_class(entry):
+    """
+    Class of a catalogue entry, from which argument names its file.
+    """
+    spec = entry.get("path_spec") or ""
+    if spec.startswith("p"):
+        return "path"
+    if spec.startswith("d"):
+        return "path-at"
+    if spec.startswith("f"):
+        return "fd"
+    return "other"
+
+
+def fingerprint(mode, errno_num, lines, injections, exit_state):
+    """
+    Return (fingerprint, outcome) for the server output of one variant.
+    """
+    seq, fails = [], 0
+    for line in lines:
+        m = FAIL_RE.search(line)
+        if not m:
+            continue
+        fails += 1
+        sc, err = m.group(1), int(m.group(2))
+        tok = f"{'self' if sc == mode else sc}:" \
+              f"{'E' if err == errno_num else err}"
+        if not seq or seq[-1] != tok:
+            seq.append(tok)
+    outcome = {
+        "seq": seq,
+        "cascade": round(fails / injections) if injections else fails,
+        "exit": exit_state,
+    }
+    digest = hashlib.sha1(json.dumps(outcome, sort_keys=True).encode())
+    return digest.hexdigest()[:12], outcome
+
+
+class OutcomeCache:
+    def __init__(self, path):
+        self.path = path
+        try:
+            with open(path, "r") as f:
+                self.data = json.load(f)
+        except (OSError, ValueError):
+            self.data = {"version": 1, "classes": {}, "outcomes": {}}
+
+    def predict(self, cls, errno_name):
+        """
+        Most frequent fingerprint seen for (class, errno), or None.
+        """
+        seen = self.data["classes"].get(cls, {}).get(errno_name)
+        if not seen:
+            return None
+        return max(seen.items(), key=lambda kv: kv[1])[0]
+
+    def record(self, cls, errno_name, fp, outcome):
+        counts = self.data["classes"].setdefault(cls, {}) \
+                                     .setdefault(errno_name, {})
+        counts[fp] = counts.get(fp, 0) + 1
+        self.data["outcomes"][fp] = outcome
+
+    def merge(self, other):
+        for cls, by_errno in other["classes"].items():
+            for name, counts in by_errno.items():
+                mine = self.data["classes"].setdefault(cls, {}) \
+                                           .setdefault(name, {})
+                for fp, n in counts.items():
+                    mine[fp] = mine.get(fp, 0) + n
+        self.data["outcomes"].update(other["outcomes"])
+
+    def save(self):
+        tmp = self.path + ".tmp"
+        with open(tmp, "w") as f:
+            json.dump(self.data, f, indent=1, sort_keys=True)
+        os.replace(tmp, self.path)
+
+
+class OutcomeRun:
+    """
+    Per-campaign view: skips variants predicted to repeat an outcome this
+    run has already produced (keeping a `sample` fraction of them), or, with
+    verify, runs everything and scores the predictions.
+    """
+
+    def __init__(self, cache, cls, mode, sample=0.0, verify=False):
+        self.cache = cache
+        self.cls = cls
+        self.mode = mode
+        self.sample = sample
+        self.verify = verify
+        self.seen = set()
+        self.hits = self.misses = self.skipped = 0
+
+    def should_skip(self, errno_name):
+        """
+        The predicted fingerprint if the variant should be skipped, else None.
+        """
+        predicted = self.cache.predict(self.cls, errno_name)
+        if self.verify or predicted is None or predicted not in self.seen:
+            return None
+        if random.random() < self.sample:
+            return None
+        self.skipped += 1
+        return predicted
+
+    def record(self, errno_name, errno_num, lines, injections, exit_state):
+        predicted = self.cache.predict(self.cls, errno_name)
+        fp, outcome = fingerprint(self.mode, errno_num, lines, injections,
+                                  exit_state)
+        if predicted is not None:
+            if predicted == fp:
+                self.hits += 1
+            else:
+                self.misses += 1
+        self.cache.record(self.cls, errno_name, fp, outcome)
+        self.seen.add(fp)
+        return fp, outcome
+
+    def summary(self):
+        checked = self.hits + self.misses
+        acc = f"{100.0 * self.hits / checked:.1f}%" if checked else "n/a"
+        return (f"outcomes={len(self.seen)} skipped={self.skipped} "
+                f"prediction_accuracy={acc} ({self.hits}/{checked})")
+
+
+def main():
+    if len(sys.argv) < 4 or sys.argv[1] != "--merge":
+        print(__doc__.strip().splitlines()[-1], file=sys.stderr)
+        sys.exit(1)
+    out = OutcomeCache(sys.argv[2])
+    for path in sys.argv[3:]:
+        with open(path, "r") as f:
+            out.merge(json.load(f))
+    out.save()
+    print(f"[OUT] Merged {len(sys.argv) - 3} caches into {sys.argv[2]}")
+
+
+if __name__ == "__main__":
+    main()
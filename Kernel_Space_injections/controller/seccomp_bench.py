@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+"""
+Compare the seccomp backend (server --seccomp=) with the kretprobe module.
+
+The server is launched once per phase, --duration seconds each:
+
+    base           no injection at all
+    kprobe-armed   module loaded in observe mode: kretprobe cost, no faults
+    bpf-armed      filter matching the syscall but allowing it (sc:0)
+    notify-armed   every call round-trips through the supervisor (sc:E%0)
+    kprobe-<ERRNO> module injects ERRNO into every call
+    bpf-<ERRNO>    filter returns ERRNO for every call (sc:ERRNO)
+
+Overhead is each armed phase's LATENCY p50/p99 minus base. Fidelity
+compares the two injecting phases of an errno: the share of iterations
+that failed and the outcome fingerprint (failing scenario sequence,
+cascade, exit state, as in outcomes.py). The backends differ where the
+kernel does: the module fails the kernel function after it ran (side
+effects included), seccomp fails the call before entry, and only for the
+syscall number the libc wrapper really uses (see --syscall=).
+
+kprobe phases are skipped when fs_injector.ko is missing or will not load,
+so the seccomp numbers are still produced on hosts without the module.
+Results are saved as JSON:
+
+    {"mode": "unlink", "syscall": "unlink",
+     "results": {"base": {"p50_us": 3.1, ...}, "bpf-EIO": {...}},
+     "fidelity": {"EIO": {"match": true, ...}}}
+
+Usage: ./seccomp_bench.py --mode=NAME [--errnos=EIO,ENOSPC] [--duration=10]
+         [--syscall=NAME] [--symbol=SYM] [--out=FILE] [--no-kprobe]
+         [--server-args="..."]
+"""
+import json
+import os
+import subprocess
+import sys
+import time
+
+from controller import (MODULE_PATH, ROOT_DIR, Campaign, find_int_opt,
+                        find_opt, load_fs_metadata, read_param, rmmod_module,
+                        server_args)
+from fs_matrix import parse_phase
+from outcomes import fingerprint
+
+
+def run_phase(ctx, symbol, duration, module=None, seccomp=None):
+    """
+    One server run, with the module loaded using module (a dict of
+    parameters) and/or the server filtering with the seccomp rules.
+    """
+    base_args = ctx.server_args
+    if seccomp:
+        ctx.server_args = base_args + [f"--seccomp={seccomp}"]
+    try:
+        if module is None:
+            ctx.start_server()
+        else:
+            ctx.load_module(symbol, max_inj=1 << 30, extra=module)
+        time.sleep(duration)
+        injections = read_param("injections_done") if module else 0
+        exit_state = ctx.exit_state()
+        ctx.stop_server()
+    finally:
+        ctx.server_args = base_args
+        if module is not None:
+            rmmod_module()
+    lines = ctx.output_since(0)
+    stats = parse_phase(lines)
+    stats["injections"] = injections
+    stats["exit"] = exit_state
+    stats["lines"] = lines
+    return stats
+
+
+def fidelity(mode, errno_num, kprobe, bpf):
+    """
+    How closely the seccomp phase of one errno reproduced the kprobe one.
+    """
+    out = {}
+    for name, st in (("kprobe", kprobe), ("bpf", bpf)):
+        n = st.get("n") or 0
+        fails = st.get("fail_iters", 0)
+        fp, outcome = fingerprint(mode, errno_num, st["lines"], fails,
+                                  st["exit"])
+        out[name] = {"fail_pct": round(100.0 * fails / n, 1) if n else 0.0,
+                     "fingerprint": fp, "outcome": outcome}
+    out["match"] = out["kprobe"]["fingerprint"] == out["bpf"]["fingerprint"]
+    return out
+
+
+def print_report(mode, results, fid):
+    base = results.get("base", {})
+    print(f"[SECCOMP] {mode}: {'phase':<16}{'p50_us':>10}{'p99_us':>10}"
+          f"{'d_p50':>10}{'d_p99':>10}{'fail_it':>9}{'cascade':>9}")
+    for phase, st in results.items():
+        if "p50_us" not in st:
+            print(f"[SECCOMP] {mode}: {phase:<16}  no LATENCY line")
+            continue
+        d50 = d99 = "-"
+        if "p50_us" in base and phase != "base":
+            d50 = f"{st['p50_us'] - base['p50_us']:.1f}"
+            d99 = f"{st['p99_us'] - base['p99_us']:.1f}"
+        print(f"[SECCOMP] {mode}: {phase:<16}{st['p50_us']:>10.1f}"
+              f"{st['p99_us']:>10.1f}{d50:>10}{d99:>10}"
+              f"{st.get('fail_iters', 0):>9}{st.get('cascade', 0.0):>9.2f}")
+    for name, f in fid.items():
+        k, b = f["kprobe"], f["bpf"]
+        print(f"[SECCOMP] {mode}: {name}: failing iterations kprobe "
+              f"{k['fail_pct']}% bpf {b['fail_pct']}%, outcome "
+              f"{'match' if f['match'] else 'DIFFERS'}")
+        if not f["match"]:
+            print(f"[SECCOMP]   kprobe {json.dumps(k['outcome'])}")
+            print(f"[SECCOMP]   bpf    {json.dumps(b['outcome'])}")
+
+
+def main():
+    mode = find_opt("mode")
+    fs_meta = load_fs_metadata()
+    if not mode or mode not in fs_meta:
+        print(__doc__.strip().split("Usage: ")[-1], file=sys.stderr)
+        sys.exit(1)
+    entry = fs_meta[mode]
+    symbol = find_opt("symbol", entry.get("canonical_guess"))
+    syscall = find_opt("syscall", mode)
+
+    variants = {ev["errno_name"]: ev["errno_num"]
+                for ev in entry.get("error_variants") or []}
+    errnos = find_opt("errnos", "EIO").split(",")
+    for name in errnos:
+        if name not in variants:
+            print(f"[SECCOMP] ERROR: {name} is not an error variant of "
+                  f"'{mode}'", file=sys.stderr)
+            sys.exit(1)
+
+    duration = find_int_opt("duration", 10)
+    workdir = os.path.join(ROOT_DIR, "seccomp_bench")
+    os.makedirs(workdir, exist_ok=True)
+    out_path = find_opt("out", os.path.join(workdir, f"bench_{mode}.json"))
+    kprobe = "--no-kprobe" not in sys.argv[1:] and os.path.exists(MODULE_PATH)
+    if not kprobe:
+        print("[SECCOMP] kprobe phases skipped")
+
+    ctx = Campaign(mode, launch=True, server_args=server_args())
+    ctx.log_path = os.path.join(workdir, "server.log")
+    results = {}
+    try:
+        results["base"] = run_phase(ctx, symbol, duration)
+        if kprobe:
+            try:
+                results["kprobe-armed"] = run_phase(ctx, symbol, duration,
+                                                    module={"fault_mode": 3})
+            except subprocess.CalledProcessError as e:
+                print(f"[SECCOMP] insmod failed ({e}), kprobe phases "
+                      f"skipped", file=sys.stderr)
+                kprobe = False
+        results["bpf-armed"] = run_phase(ctx, symbol, duration,
+                                         seccomp=f"{syscall}:0")
+        results["notify-armed"] = run_phase(
+            ctx, symbol, duration,
+            seccomp=f"{syscall}:{variants[errnos[0]]}%0")
+        for name in errnos:
+            if kprobe:
+                results[f"kprobe-{name}"] = run_phase(
+                    ctx, symbol, duration,
+                    module={"inject_errno": variants[name]})
+            results[f"bpf-{name}"] = run_phase(
+                ctx, symbol, duration,
+                seccomp=f"{syscall}:{variants[name]}")
+    finally:
+        ctx.stop_server()
+        if kprobe:
+            rmmod_module()
+
+    fid = {}
+    if kprobe:
+        for name in errnos:
+            fid[name] = fidelity(mode, variants[name],
+                                 results[f"kprobe-{name}"],
+                                 results[f"bpf-{name}"])
+    for st in results.values():
+        st.pop("lines")
+    print_report(mode, results, fid)
+    with open(out_path, "w") as f:
+        json.dump({"mode": mode, "symbol": symbol, "syscall": syscall,
+                   "duration": duration, "results": results,
+                   "fidelity": fid}, f, indent=1)
+    print(f"[SECCOMP] Saved {out_path}")
+
+
+if __name__ == "__main__":
+    main()
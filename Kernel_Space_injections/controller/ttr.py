@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""
+Rank faults by operational cost from the server's RECOVERY lines.
+
+The server closes a recovery episode when --ttr-k iterations in a row
+succeed after a failure, and prints
+
+    [SERVER] openat RECOVERY sc=openat errno=5 recovered=1 ttr_ms=812.3
+             failed_iters=4 lost_ops=3.6 lost_pct=90.0
+
+This tool merges those lines from any number of server logs (launched
+servers write them to --server-log=FILE, or server_<mode>.log with
+--fingerprint). It prints one row per (syscall, errno): the episode count
+and the TTR distribution. Rows are ranked by total lost throughput, or by
+--sort=p50|p99|episodes.
+
+Usage: ./ttr.py LOG [LOG...] [--sort=lost|p50|p99|episodes]
+"""
+import errno
+import re
+import sys
+
+from controller import find_opt
+
+RECOVERY_RE = re.compile(r"\[SERVER\] (\S+) RECOVERY sc=(\S+) errno=(\d+) "
+                         r"recovered=(\d) ttr_ms=([\d.]+) failed_iters=\d+ "
+                         r"lost_ops=([\d.]+)")
+
+
+def pct(sorted_vals, p):
+    if not sorted_vals:
+        return 0.0
+    i = min(len(sorted_vals) - 1, int(p / 100.0 * len(sorted_vals)))
+    return sorted_vals[i]
+
+
+def main():
+    logs = [a for a in sys.argv[1:] if not a.startswith("--")]
+    if not logs:
+        print(__doc__.strip().splitlines()[-1], file=sys.stderr)
+        sys.exit(1)
+    sort = find_opt("sort", "lost")
+    if sort not in ("lost", "p50", "p99", "episodes"):
+        print(f"[TTR] ERROR: unknown --sort={sort}", file=sys.stderr)
+        sys.exit(1)
+
+    episodes = {}
+    for path in logs:
+        with open(path, "r", errors="replace") as f:
+            for line in f:
+                m = RECOVERY_RE.search(line)
+                if not m:
+                    continue
+                mode, sc, err, ok, ttr_ms, lost = m.groups()
+                rows = episodes.setdefault((mode, sc, int(err)), [])
+                rows.append((int(ok), float(ttr_ms), float(lost)))
+
+    table = []
+    for (mode, sc, err), rows in episodes.items():
+        ttrs = sorted(t for ok, t, _ in rows if ok)
+        table.append({
+            "key": f"{mode}:{sc}" if sc != mode else mode,
+            "errno": errno.errorcode.get(err, str(err)),
+            "episodes": len(rows),
+            "unrecovered": sum(1 for ok, _, _ in rows if not ok),
+            "p50": pct(ttrs, 50), "p90": pct(ttrs, 90), "p99": pct(ttrs, 99),
+            "max": ttrs[-1] if ttrs else 0.0,
+            "lost": sum(lost for _, _, lost in rows),
+        })
+    table.sort(key=lambda r: r[sort], reverse=True)
+
+    print(f"[TTR] {'syscall':<20} {'errno':<12} {'episodes':>8} "
+          f"{'unrec':>6} {'p50_ms':>9} {'p90_ms':>9} {'p99_ms':>9} "
+          f"{'max_ms':>9} {'lost_ops':>9}")
+    for r in table:
+        print(f"[TTR] {r['key']:<20} {r['errno']:<12} {r['episodes']:>8} "
+              f"{r['unrecovered']:>6} {r['p50']:>9.1f} {r['p90']:>9.1f} "
+              f"{r['p99']:>9.1f} {r['max']:>9.1f} {r['lost']:>9.1f}")
+
+
+if __name__ == "__main__":
+    main()
@@ -1,6 +1,7 @@
 #!/usr/bin/env python3
 import json
 import errno
+import sys
 from pathlib import Path
 
 # --------------------------------------------------------------------
@@ -70,6 +71,17 @@ MODES = [
     "utimensat",
     "utimes",
     "vmsplice",
+    # data-path streaming modes
+    "read",
+    "write",
+    "pread64",
+    "pwritev",
+    "preadv2",
+    # memory-mapped modes
+    "mmap",
+    "msync",
+    "madvise",
+    "mremap",
 ]
 
 # --------------------------------------------------------------------
@@ -140,6 +152,75 @@ SYSCALL_SYMBOLS = {
     "utimensat":        "__x64_sys_utimensat",
     "utimes":           "__x64_sys_utimes",
     "vmsplice":         "__x64_sys_vmsplice",
+    "read":             "__x64_sys_read",
+    "write":            "__x64_sys_write",
+    "pread64":          "__x64_sys_pread64",
+    "pwritev":          "__x64_sys_pwritev",
+    "preadv2":          "__x64_sys_preadv2",
+    "mmap":             "__x64_sys_mmap",
+    "msync":            "__x64_sys_msync",
+    "madvise":          "__x64_sys_madvise",
+    "mremap":           "__x64_sys_mremap",
+}
+
+# --------------------------------------------------------------------
+# 2b. 0-based index of the byte-length argument, for short-count
+#     (partial I/O) injection. Only syscalls that return a byte count.
+# --------------------------------------------------------------------
+COUNT_ARGS = {
+    "read":            2,
+    "write":           2,
+    "pread64":         2,
+    "sendfile":        3,
+    "splice":          4,
+    "copy_file_range": 4,
+    "tee":             2,
+    "getdents":        2,
+    "getdents64":      2,
+}
+
+# --------------------------------------------------------------------
+# 2c. Which arguments name the file, for the injector's path-prefix
+#     filter: pN = pathname, dN = dirfd it is relative to, fN = fd.
+#     Syscalls without an entry (pipes, sync, mount) are not filtered.
+# --------------------------------------------------------------------
+PATH_SPECS = {
+    # path-centric
+    "access": "p0", "chdir": "p0", "chmod": "p0", "chown": "p0",
+    "lchown": "p0", "link": "p0", "lstat": "p0", "mkdir": "p0",
+    "mknod": "p0", "open": "p0", "readlink": "p0", "rename": "p0",
+    "rmdir": "p0", "stat": "p0", "statfs": "p0", "symlink": "p1",
+    "truncate": "p0", "unlink": "p0", "utime": "p0", "utimes": "p0",
+    # dirfd-relative
+    "faccessat2": "d0p1", "fchmodat": "d0p1", "fchownat": "d0p1",
+    "fspick": "d0p1", "linkat": "d0p1", "mkdirat": "d0p1",
+    "mknodat": "d0p1", "open_tree": "d0p1", "openat": "d0p1",
+    "openat2": "d0p1", "readlinkat": "d0p1", "renameat": "d0p1",
+    "renameat2": "d0p1", "statx": "d0p1", "symlinkat": "d1p2",
+    "unlinkat": "d0p1", "utimensat": "d0p1",
+    # fd-centric
+    "close": "f0", "copy_file_range": "f0", "fallocate": "f0",
+    "fchdir": "f0", "fchmod": "f0", "fchown": "f0", "fdatasync": "f0",
+    "fsetxattr": "f0", "fstat": "f0", "fstatfs": "f0", "fsync": "f0",
+    "ftruncate": "f0", "getdents": "f0", "getdents64": "f0",
+    "readahead": "f0", "sendfile": "f1", "splice": "f0",
+    "read": "f0", "write": "f0", "pread64": "f0", "pwritev": "f0",
+    "preadv2": "f0", "mmap": "f4",
+}
+
+# --------------------------------------------------------------------
+# 2d. Kernel functions on a mode's page-cache path, hooked instead of the
+#     syscall with controller.py --probe=. ":vmfault" marks functions that
+#     return vm_fault_t; the injector turns their errno into SIGBUS/OOM.
+# --------------------------------------------------------------------
+INTERNAL_PROBES = {
+    "mmap":    ["filemap_fault:vmfault", "filemap_page_mkwrite:vmfault"],
+    "msync":   ["vfs_fsync_range", "file_write_and_wait_range",
+                "file_check_and_advance_wb_err", "do_writepages"],
+    "madvise": ["vfs_fadvise", "filemap_fault:vmfault"],
+    "mremap":  ["filemap_fault:vmfault"],
+    "fsync":   ["vfs_fsync_range", "file_check_and_advance_wb_err"],
+    "fdatasync": ["vfs_fsync_range", "file_check_and_advance_wb_err"],
 }
 
 # --------------------------------------------------------------------
@@ -176,61 +257,77 @@ ERRNO_NAMES = [
     "EOPNOTSUPP",
 ]
 
-def build_error_variants():
-    variants = []
-    for name in ERRNO_NAMES:
-        num = getattr(errno, name, None)
-        if num is None:
-            continue
-        variants.append({
-            "errno_name": name,
-            "errno_num": num,
-            "kernel_ret": -num,
-            "userspace_return_pattern": f"-1 and errno set to {num}",
-            "source": "candidates",
-            "note": "automatic candidate list",
-            "forceable": True,
-            "side_effects": "maybe",
-            "safety_level": "low",
-        })
-    return variants
-
-# --------------------------------------------------------------------
-# 4. Build full JSON structure
+# --------------------------------------------------------------------
+# 3b. Named errno sets and per-syscall overrides. Entries use
+#     DEFAULT_ERRNO_SET unless overridden here with "errno_set",
+#     "errnos", "errnos_add" or "errnos_remove" (see controller/catalogue.py).
+# --------------------------------------------------------------------
+ERRNO_SETS = {
+    "fs": ERRNO_NAMES,
+    # mapping syscalls, and writeback errors reported through msync
+    "mm": ["EACCES", "EAGAIN", "EBADF", "EBUSY", "EFAULT", "EINVAL", "EIO",
+           "ENODEV", "ENOMEM", "ENOSPC", "EOVERFLOW", "EPERM", "ETXTBSY"],
+}
+DEFAULT_ERRNO_SET = "fs"
+
+ERRNO_OVERRIDES = {
+    "mmap":    {"errno_set": "mm"},
+    "msync":   {"errno_set": "mm"},
+    "madvise": {"errno_set": "mm"},
+    "mremap":  {"errno_set": "mm"},
+}
+
+# Written back by errno discovery (controller.py --discover); kept when
+# the catalogue is regenerated
+DISCOVERED_KEYS = ("errnos", "discovered")
+
+# --------------------------------------------------------------------
+# 4. Build the normalized catalogue and its binary index
 # --------------------------------------------------------------------
 def main():
     base = Path(__file__).resolve().parent
     json_dir = base / "json"
     json_dir.mkdir(exist_ok=True)
-    out_path = json_dir / "file_system.json"
+    out_path = json_dir / "catalogue.json"
 
-    variants = build_error_variants()
-    entries = []
+    previous = {}
+    if out_path.exists():
+        with out_path.open() as f:
+            previous = json.load(f).get("syscalls", {})
 
+    syscalls = {}
     for name in MODES:
-        sym = SYSCALL_SYMBOLS.get(name)
-        entry = {
-            "name": name,
-            "canonical_guess": sym,
-            "symbol_to_probe": None,          # controller will fill / override if needed
-            "probeable": bool(sym),
-            "category": "file",               # treat all as FS for this project
-            "nr_args": 0,                     # not needed for return-value injection
-            "args": [],
-            "return_type": "long",
-            "forceable_by_type": True,
-            "side_effects_note": "maybe",
-            "error_variants": variants,
-            "probe_commands_suggestion": None,
-            "notes": "Generated by generate_fs_json.py for FS fault-injection project.",
-        }
-        entries.append(entry)
+        entry = {"symbol": SYSCALL_SYMBOLS.get(name)}
+        if name in COUNT_ARGS:
+            entry["count_arg"] = COUNT_ARGS[name]
+        if name in PATH_SPECS:
+            entry["path_spec"] = PATH_SPECS[name]
+        if name in INTERNAL_PROBES:
+            entry["probes"] = INTERNAL_PROBES[name]
+        entry.update(ERRNO_OVERRIDES.get(name, {}))
+        for key in DISCOVERED_KEYS:
+            if key in previous.get(name, {}) and key not in entry:
+                entry[key] = previous[name][key]
+        syscalls[name] = entry
+
+    catalogue = {
+        "version": 1,
+        "default_errno_set": DEFAULT_ERRNO_SET,
+        "errno_sets": {k: [n for n in v if hasattr(errno, n)]
+                       for k, v in ERRNO_SETS.items()},
+        "syscalls": syscalls,
+    }
 
     with out_path.open("w") as f:
-        json.dump(entries, f, indent=2, sort_keys=False)
+        json.dump(catalogue, f, indent=1)
+        f.write("\n")
 
-    print(f"[GEN] Wrote {len(entries)} syscall entries to {out_path}")
+    print(f"[GEN] Wrote {len(syscalls)} syscall entries to {out_path}")
+
+    sys.path.insert(0, str(base / "controller"))
+    from catalogue import compile_index, INDEX_PATH
+    compile_index()
+    print(f"[GEN] Compiled index {INDEX_PATH}")
 
 if __name__ == "__main__":
     main()
-
@@ -6,6 +6,36 @@
 #include <linux/errno.h>
 #include <linux/ktime.h>
 #include <linux/atomic.h>
+#include <linux/ptrace.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/random.h>
+#include <linux/delay.h>
+#include <linux/task_work.h>
+#include <linux/hash.h>
+#include <linux/spinlock.h>
+#include <linux/mutex.h>
+#include <linux/wait.h>
+#include <linux/sort.h>
+#include <linux/bsearch.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include <linux/percpu.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/fs_struct.h>
+#include <linux/dcache.h>
+#include <linux/path.h>
+#include <linux/fcntl.h>
+#include <linux/cgroup.h>
+#include <linux/pid_namespace.h>
+#include <linux/rcupdate.h>
+#include <linux/mm.h>
+#include <linux/pagemap.h>
+#include <linux/math64.h>
+#include <linux/bitmap.h>
+#include <linux/overflow.h>
 
 MODULE_LICENSE("GPL");
 MODULE_AUTHOR("You");
@@ -14,101 +44,2266 @@ MODULE_DESCRIPTION("Generic FS syscall fault injector using kretprobe");
 /*
  * Module parameters:
  *
- *  target_symbol   : symbol name to hook (e.g., "__x64_sys_readlink")
+ *  target_symbol   : symbol(s) to hook, comma separated
+ *                    (e.g., "__x64_sys_fsync,__x64_sys_fdatasync")
  *  target_pid      : only inject for this PID (0 = all)
+ *  target_comm     : only inject for tasks with this comm ("" = all); lets
+ *                    the module be loaded before the target is started
+ *  target_cgroups  : only inject for tasks in (or below) these cgroup v2 ids,
+ *                    comma separated, writable at runtime ("" = all)
+ *  callsite_depth  : user frames hashed into a call-site fingerprint
+ *                    (0 = off); hits are listed in debugfs fs_injector/callsites
+ *  target_callsites: only inject at these fingerprints, comma separated,
+ *                    writable at runtime ("" = all)
  *  inject_errno    : positive errno number to inject (e.g., 13 for EACCES)
  *  max_injections  : maximum number of injections before auto-stop
  *  unsafe_mode     : 0 = only override failing calls, 1 = override successes too
+ *  inject_every    : only every Nth eligible call is overridden (1 = all)
+ *  fault_mode      : 0 = errno (return -inject_errno), 1 = short count,
+ *                    2 = delay (return value untouched, return is late),
+ *                    3 = observe (never inject, only count natural returns)
+ *  short_pct       : short mode: percent of the requested length to allow
+ *  short_cap       : short mode: byte cap on the requested length (0 = none)
+ *  count_arg       : short mode: index of the syscall's length argument
+ *  delay_spec      : delay mode: per-symbol delay in microseconds, fixed or
+ *                    as quantiles, e.g. "__x64_sys_fsync=p50:200,p99:50000;
+ *                    __x64_sys_openat=100" (no "sym=" applies to all)
+ *  delay_spin_us   : delay mode: busy-wait up to this many us in the handler,
+ *                    longer delays sleep on the task's way back to user mode
+ *                    (and are skipped if that cannot be arranged)
+ *  path_prefixes   : only inject calls whose path lies under one of these
+ *                    comma-separated absolute prefixes ("" = no filter)
+ *  path_spec       : which arguments carry the path, per symbol:
+ *                    "sym=p0;sym=d0p1;sym=f0" (p = pathname, d = dirfd,
+ *                    f = fd). Symbols without a spec are not path-filtered
+ *  path_rejects    : (read-only) calls skipped by the path filter
+ *  errno_allow     : errnos each symbol can really return, from the
+ *                    catalogue: "sym=bitmap;..." with bitmap in hex, 32-bit
+ *                    words comma separated (bit n = errno n). An injection
+ *                    of any other errno into sym is dropped. Symbols
+ *                    without a bitmap may fail with any errno
+ *  errno_rejects   : (read-only) inject_errno settings, and chain, burst and
+ *                    replay injections, dropped by errno_allow
+ *  chain_spec      : per-task multi-fault chain, "sym:errno[*n],sym:errno..."
+ *                    Each task fails its next n (default 1) calls to the
+ *                    step's symbol, then moves to the next step; after the
+ *                    last step it is left alone. Chain symbols are hooked
+ *                    automatically. Replaces inject_errno/max_injections
+ *  vmfault_symbols : hooked symbols that return vm_fault_t rather than
+ *                    -errno and take the struct vm_fault as their first
+ *                    argument (e.g. "filemap_fault"); an injected ENOMEM
+ *                    becomes VM_FAULT_OOM and any other errno VM_FAULT_SIGBUS.
+ *                    Only returns of 0, error bits or a plain LOCKED page
+ *                    are replaced
+ *  burst_spec      : burst group, "sym[:errno],..." (errno defaults to EIO;
+ *                    "" = every hooked symbol with EIO). Group symbols are
+ *                    hooked automatically
+ *  burst_window    : "start_ns,len_ms[,period_ms]" on CLOCK_MONOTONIC, or
+ *                    "now,len_ms[,period_ms]"; writable at runtime ("" = off).
+ *                    Every matched call to a group symbol that enters inside
+ *                    a window fails, whatever the budget and rate
+ *  burst_injections: (read-only) injections made by burst windows
+ *  record          : log every injection to debugfs fs_injector/schedule
+ *  replay          : inject exactly the schedule written to that file
  *  injections_done : (read-only) total injections performed
+ *
+ * Natural returns of every matched call (before any override) are counted
+ * per CPU and per symbol by errno; debugfs fs_injector/errors sums them.
+ * debugfs fs_injector/metrics has these, injections by errno, filter
+ * rejects and kretprobe misses in Prometheus text format.
+ */
+
+#define FAULT_ERRNO  0
+#define FAULT_SHORT  1
+#define FAULT_DELAY  2
+#define FAULT_OBSERVE 3
+
+#define MAX_PROBES    8
+#define DELAY_POINTS  8
+#define ERRNO_SLOTS   134       /* errno 1..133 (EHWPOISON) */
+
+static char *target_symbol = "__x64_sys_readlink";
+module_param(target_symbol, charp, 0644);
+MODULE_PARM_DESC(target_symbol,
+                 "Kernel symbol(s) to hook, comma separated (e.g., \"__x64_sys_readlink\")");
+
+static int target_pid = 0;
+module_param(target_pid, int, 0644);
+MODULE_PARM_DESC(target_pid, "PID to target. 0 = all tasks");
+
+static char *target_comm = "";
+module_param(target_comm, charp, 0444);
+MODULE_PARM_DESC(target_comm, "Only target tasks with this comm. \"\" = any");
+
+/*
+ * cgroup and call-site targeting: small RCU-published id sets, replaced
+ * wholesale on every sysfs write so the hot path never takes a lock.
+ * kp->arg points at the set's RCU pointer.
+ */
+#define MAX_IDS  16
+
+struct fs_id_set {
+    struct rcu_head rcu;
+    int n;
+    u64 ids[MAX_IDS];
+};
+
+static struct fs_id_set __rcu *fs_cgroups;
+static struct fs_id_set __rcu *fs_callsites;
+static DEFINE_MUTEX(fs_idset_lock);
+
+static int fs_idset_set(const char *val, const struct kernel_param *kp)
+{
+    struct fs_id_set __rcu **slot = kp->arg;
+    struct fs_id_set *set, *old;
+    char *buf, *cur, *tok;
+    int ret = 0;
+
+    set = kzalloc(sizeof(*set), GFP_KERNEL);
+    buf = kstrdup(val, GFP_KERNEL);
+    if (!set || !buf) {
+        kfree(set);
+        kfree(buf);
+        return -ENOMEM;
+    }
+
+    cur = strim(buf);
+    while ((tok = strsep(&cur, ",")) != NULL) {
+        if (!*tok)
+            continue;
+        if (set->n >= MAX_IDS) {
+            ret = -E2BIG;
+            break;
+        }
+        ret = kstrtou64(tok, 0, &set->ids[set->n]);
+        if (ret)
+            break;
+        set->n++;
+    }
+    kfree(buf);
+    if (ret) {
+        kfree(set);
+        return ret;
+    }
+
+    if (set->n == 0) {
+        kfree(set);
+        set = NULL;
+    }
+
+    mutex_lock(&fs_idset_lock);
+    old = rcu_replace_pointer(*slot, set, lockdep_is_held(&fs_idset_lock));
+    mutex_unlock(&fs_idset_lock);
+    if (old)
+        kfree_rcu(old, rcu);
+    return 0;
+}
+
+static int fs_idset_get(char *buffer, const struct kernel_param *kp)
+{
+    struct fs_id_set __rcu **slot = kp->arg;
+    const struct fs_id_set *set;
+    /* cgroup ids as printed by the kernel, fingerprints in hex */
+    const char *fmt = slot == &fs_callsites ? "%s0x%llx" : "%s%llu";
+    int i, len = 0;
+
+    rcu_read_lock();
+    set = rcu_dereference(*slot);
+    for (i = 0; set && i < set->n; i++)
+        len += scnprintf(buffer + len, PAGE_SIZE - len, fmt,
+                         i ? "," : "", set->ids[i]);
+    rcu_read_unlock();
+    len += scnprintf(buffer + len, PAGE_SIZE - len, "\n");
+    return len;
+}
+
+static const struct kernel_param_ops fs_idset_ops = {
+    .set = fs_idset_set,
+    .get = fs_idset_get,
+};
+
+module_param_cb(target_cgroups, &fs_idset_ops, &fs_cgroups, 0644);
+MODULE_PARM_DESC(target_cgroups,
+                 "cgroup v2 ids to target (task or ancestor). \"\" = any");
+
+static int callsite_depth = 0;
+module_param(callsite_depth, int, 0444);
+MODULE_PARM_DESC(callsite_depth,
+                 "User frames in the call-site fingerprint (0 = off, max 8)");
+
+module_param_cb(target_callsites, &fs_idset_ops, &fs_callsites, 0644);
+MODULE_PARM_DESC(target_callsites,
+                 "Call-site fingerprints to target, e.g. 0x1a2b... \"\" = any");
+
+static int inject_errno = 13;   // default: EACCES (param registered with errno_allow)
+
+static int max_injections = 1;
+module_param(max_injections, int, 0644);
+MODULE_PARM_DESC(max_injections,
+                 "Number of injections allowed before auto-stop");
+
+static int unsafe_mode = 1;
+module_param(unsafe_mode, int, 0644);
+MODULE_PARM_DESC(unsafe_mode,
+                 "0 = only modify failing calls; 1 = allow overriding successful calls too");
+
+static int inject_every = 1;
+module_param(inject_every, int, 0644);
+MODULE_PARM_DESC(inject_every,
+                 "Inject on every Nth eligible call (1 = every call), sets the fault rate");
+
+static int fault_mode = FAULT_ERRNO;
+module_param(fault_mode, int, 0444);
+MODULE_PARM_DESC(fault_mode,
+                 "0 = errno injection; 1 = short-count (partial I/O); 2 = delay; "
+                 "3 = observe only");
+
+static int short_pct = 50;
+module_param(short_pct, int, 0644);
+MODULE_PARM_DESC(short_pct,
+                 "Short mode: percent of the requested length the call may transfer");
+
+static long short_cap = 0;
+module_param(short_cap, long, 0644);
+MODULE_PARM_DESC(short_cap, "Short mode: byte cap on the requested length (0 = none)");
+
+static int count_arg = -1;
+module_param(count_arg, int, 0444);
+MODULE_PARM_DESC(count_arg,
+                 "Short mode: 0-based index of the length argument (e.g. 2 for write)");
+
+static char *delay_spec = "";
+module_param(delay_spec, charp, 0444);
+MODULE_PARM_DESC(delay_spec,
+                 "Delay mode: [sym=]<us> | [sym=]pNN:<us>,... separated by ';'");
+
+static int delay_spin_us = 100;
+module_param(delay_spin_us, int, 0644);
+MODULE_PARM_DESC(delay_spin_us,
+                 "Delay mode: busy-wait threshold in us; longer delays sleep");
+
+static char *path_prefixes = "";
+module_param(path_prefixes, charp, 0444);
+MODULE_PARM_DESC(path_prefixes,
+                 "Comma-separated absolute path prefixes eligible for injection");
+
+static char *path_spec = "";
+module_param(path_spec, charp, 0444);
+MODULE_PARM_DESC(path_spec,
+                 "Path-carrying arguments per symbol, e.g. \"__x64_sys_openat=d0p1\"");
+
+static atomic_t path_rejects_atomic = ATOMIC_INIT(0);
+static atomic_t callsite_rejects = ATOMIC_INIT(0);
+static int path_rejects;
+module_param(path_rejects, int, 0444);
+MODULE_PARM_DESC(path_rejects, "Calls skipped by the path-prefix filter (read-only)");
+
+static char *errno_allow = "";
+module_param(errno_allow, charp, 0444);
+MODULE_PARM_DESC(errno_allow,
+                 "Allowed errnos per symbol, e.g. \"__x64_sys_fsync=220\" = EIO, EBADF");
+
+static atomic_t errno_rejects_atomic = ATOMIC_INIT(0);
+static int errno_rejects;
+module_param(errno_rejects, int, 0444);
+MODULE_PARM_DESC(errno_rejects,
+                 "inject_errno settings and injections dropped by the errno allowlist (read-only)");
+
+static char *vmfault_symbols = "";
+module_param(vmfault_symbols, charp, 0444);
+MODULE_PARM_DESC(vmfault_symbols,
+                 "Hooked symbols returning vm_fault_t, comma separated");
+
+static char *burst_spec = "";
+module_param(burst_spec, charp, 0444);
+MODULE_PARM_DESC(burst_spec,
+                 "Burst group, e.g. \"__x64_sys_read,__x64_sys_write:28\" (\"\" = all, EIO)");
+
+/*
+ * Burst windows are measured on CLOCK_MONOTONIC (ktime_get_ns()), the clock
+ * the server and the controller read too. A window is published as one RCU
+ * pointer so the hot path never sees a start from one write and a length
+ * from another.
+ */
+struct fs_burst_win {
+    struct rcu_head rcu;
+    u64 start;
+    u64 len;
+    u64 period;     /* 0 = a single window */
+};
+
+static struct fs_burst_win __rcu *fs_burst;
+static DEFINE_MUTEX(fs_burst_lock);
+
+static int fs_burst_set(const char *val, const struct kernel_param *kp)
+{
+    struct fs_burst_win *w = NULL, *old;
+    u64 start, len_ms, period_ms = 0;
+    char *buf, *cur, *tok;
+    int ret = -EINVAL;
+
+    buf = kstrdup(val, GFP_KERNEL);
+    if (!buf)
+        return -ENOMEM;
+    cur = strim(buf);
+    if (!*cur || !strcmp(cur, "0")) {
+        ret = 0;
+        goto publish;
+    }
+
+    tok = strsep(&cur, ",");
+    if (!strcmp(tok, "now"))
+        start = ktime_get_ns();
+    else if (kstrtou64(tok, 10, &start))
+        goto out;
+    tok = strsep(&cur, ",");
+    if (!tok || kstrtou64(tok, 10, &len_ms) || !len_ms)
+        goto out;
+    tok = strsep(&cur, ",");
+    if (tok && kstrtou64(tok, 10, &period_ms))
+        goto out;
+    if (period_ms && period_ms < len_ms)
+        goto out;
+
+    w = kzalloc(sizeof(*w), GFP_KERNEL);
+    if (!w) {
+        ret = -ENOMEM;
+        goto out;
+    }
+    w->start = start;
+    w->len = len_ms * NSEC_PER_MSEC;
+    w->period = period_ms * NSEC_PER_MSEC;
+    ret = 0;
+
+publish:
+    mutex_lock(&fs_burst_lock);
+    old = rcu_replace_pointer(fs_burst, w, lockdep_is_held(&fs_burst_lock));
+    mutex_unlock(&fs_burst_lock);
+    if (old)
+        kfree_rcu(old, rcu);
+out:
+    kfree(buf);
+    return ret;
+}
+
+static int fs_burst_get(char *buffer, const struct kernel_param *kp)
+{
+    const struct fs_burst_win *w;
+    int len = 0;
+
+    rcu_read_lock();
+    w = rcu_dereference(fs_burst);
+    if (w)
+        len = scnprintf(buffer, PAGE_SIZE, "%llu,%llu,%llu",
+                        w->start, div_u64(w->len, NSEC_PER_MSEC),
+                        div_u64(w->period, NSEC_PER_MSEC));
+    rcu_read_unlock();
+    len += scnprintf(buffer + len, PAGE_SIZE - len, "\n");
+    return len;
+}
+
+static const struct kernel_param_ops fs_burst_ops = {
+    .set = fs_burst_set,
+    .get = fs_burst_get,
+};
+
+module_param_cb(burst_window, &fs_burst_ops, NULL, 0644);
+MODULE_PARM_DESC(burst_window,
+                 "Burst window \"start_ns|now,len_ms[,period_ms]\" (CLOCK_MONOTONIC)");
+
+static atomic_t burst_injections_atomic = ATOMIC_INIT(0);
+static int burst_injections;
+module_param(burst_injections, int, 0444);
+MODULE_PARM_DESC(burst_injections, "Injections made by burst windows (read-only)");
+
+static char *chain_spec = "";
+module_param(chain_spec, charp, 0444);
+MODULE_PARM_DESC(chain_spec,
+                 "Per-task fault chain, e.g. \"__x64_sys_openat:24,__x64_sys_close:5\"");
+
+static int record = 0;
+module_param(record, int, 0444);
+MODULE_PARM_DESC(record,
+                 "1 = record (task, symbol, call index, value) of every injection");
+
+static int replay = 0;
+module_param(replay, int, 0444);
+MODULE_PARM_DESC(replay,
+                 "1 = inject only the schedule written to debugfs fs_injector/schedule");
+
+/* Expose injections_done via sysfs as read-only int */
+static atomic_t injections_done_atomic = ATOMIC_INIT(0);
+static int injections_done;
+module_param(injections_done, int, 0444);
+MODULE_PARM_DESC(injections_done, "Total number of injections performed (read-only)");
+
+static atomic_t inj_id = ATOMIC_INIT(0);
+static atomic_t eligible_calls = ATOMIC_INIT(0);
+
+/*
+ * Latency distribution: piecewise-linear between (quantile, delay) points,
+ * starting from an implicit (p0, 0). A fixed delay is p0:d,p100:d.
+ */
+struct fs_delay {
+    int npoints;
+    u32 q[DELAY_POINTS];    /* quantile in basis points, p99 = 9900 */
+    u32 us[DELAY_POINTS];   /* delay at that quantile */
+};
+
+/* One kretprobe per hooked symbol */
+struct fs_probe {
+    struct kretprobe rp;
+    const char      *symbol;
+    struct fs_delay  delay;
+    s8               path_arg;    /* pathname argument, -1 = none */
+    s8               dirfd_arg;   /* dirfd the pathname is relative to */
+    s8               fd_arg;      /* fd-centric: argument naming the file */
+    bool             vmfault;     /* returns vm_fault_t, not -errno */
+    int              burst_errno; /* errno in a burst window, 0 = not in the group */
+    bool             errno_check; /* errno_allow has a bitmap for it */
+    int              inject_err;  /* inject_errno, 0 if errno_allow drops it */
+    DECLARE_BITMAP(errno_allow, ERRNO_SLOTS);
+};
+
+static struct fs_probe fs_probes[MAX_PROBES];
+static int fs_nprobes;
+static char *fs_symbols_buf;    /* backing store for fs_probes[].symbol */
+
+static struct fs_probe *fs_probe_of(struct kretprobe_instance *ri)
+{
+    return container_of(get_kretprobe(ri), struct fs_probe, rp);
+}
+
+/* Long delays: sleep in task_work on return to user mode */
+struct fs_sleep_work {
+    struct callback_head cb;
+    u32 us;
+};
+
+/* Queued fs_sleep_fn() calls; module exit waits for them to drain */
+static atomic_t fs_sleepers = ATOMIC_INIT(0);
+static DECLARE_WAIT_QUEUE_HEAD(fs_sleepers_wq);
+
+/* task_work_add() is not exported; resolved through a kprobe at init */
+static int (*fs_task_work_add)(struct task_struct *task,
+                               struct callback_head *work,
+                               enum task_work_notify_mode notify);
+
+static void *fs_lookup_symbol(const char *name)
+{
+    struct kprobe kp = { .symbol_name = name };
+    void *addr;
+
+    if (register_kprobe(&kp) < 0)
+        return NULL;
+    addr = kp.addr;
+    unregister_kprobe(&kp);
+    return addr;
+}
+
+static void fs_sleep_fn(struct callback_head *cb)
+{
+    struct fs_sleep_work *w = container_of(cb, struct fs_sleep_work, cb);
+
+    if (w->us >= 20000)
+        msleep(w->us / 1000);
+    else
+        usleep_range(w->us, w->us + w->us / 8 + 1);
+    kfree(w);
+    /*
+     * Exit waits for the count to drain and then for a grace period, so
+     * dropping it inside a read section keeps this code mapped until the
+     * callback is done with it.
+     */
+    rcu_read_lock();
+    if (atomic_dec_and_test(&fs_sleepers))
+        wake_up(&fs_sleepers_wq);
+    rcu_read_unlock();
+}
+
+static u32 fs_delay_sample(const struct fs_delay *d)
+{
+    u32 u, q0 = 0, v0 = 0;
+    int i;
+
+    if (d->npoints == 0)
+        return 0;
+
+    u = get_random_u32_below(10000);
+    for (i = 0; i < d->npoints; i++) {
+        if (u <= d->q[i]) {
+            if (d->q[i] == q0)
+                return d->us[i];
+            return v0 + (u64)(d->us[i] - v0) * (u - q0) / (d->q[i] - q0);
+        }
+        q0 = d->q[i];
+        v0 = d->us[i];
+    }
+    return v0;
+}
+
+/*
+ * Busy-wait short delays, defer long ones to a sleepable context. A long
+ * delay that cannot be deferred is not made at all (false): spinning for
+ * it would hold the CPU with preemption off.
+ */
+static bool fs_apply_delay(u32 us)
+{
+    struct fs_sleep_work *w;
+
+    if (us > delay_spin_us) {
+        if (!fs_task_work_add)
+            return false;
+        w = kmalloc(sizeof(*w), GFP_ATOMIC);
+        if (!w)
+            return false;
+        init_task_work(&w->cb, fs_sleep_fn);
+        w->us = us;
+        atomic_inc(&fs_sleepers);
+        if (fs_task_work_add(current, &w->cb, TWA_RESUME) == 0)
+            return true;
+        atomic_dec(&fs_sleepers);
+        kfree(w);
+        return false;
+    }
+
+    while (us > 0) {
+        u32 chunk = us > 1000 ? 1000 : us;
+        udelay(chunk);
+        us -= chunk;
+    }
+    return true;
+}
+
+/* "200", "5ms", "p99:50000", "p99.9:2ms" -> quantile (bp) and delay (us) */
+static int fs_parse_point(char *tok, u32 *q, u32 *us)
+{
+    char *val = tok;
+    unsigned int mult = 1;
+    size_t len;
+    int ret;
+
+    *q = 10000;
+    if (tok[0] == 'p') {
+        char *colon = strchr(tok, ':');
+        char *dot;
+        u32 whole, frac = 0;
+
+        if (!colon)
+            return -EINVAL;
+        *colon = '\0';
+        val = colon + 1;
+
+        dot = strchr(tok + 1, '.');
+        if (dot) {
+            *dot = '\0';
+            /* two fractional digits of a percent = basis points */
+            if (strlen(dot + 1) > 2 || kstrtou32(dot + 1, 10, &frac))
+                return -EINVAL;
+            if (strlen(dot + 1) == 1)
+                frac *= 10;
+        }
+        ret = kstrtou32(tok + 1, 10, &whole);
+        if (ret || whole > 100)
+            return -EINVAL;
+        *q = whole * 100 + frac;
+        if (*q > 10000)
+            return -EINVAL;
+    }
+
+    len = strlen(val);
+    if (len > 2 && !strcmp(val + len - 2, "ms")) {
+        val[len - 2] = '\0';
+        mult = 1000;
+    } else if (len > 2 && !strcmp(val + len - 2, "us")) {
+        val[len - 2] = '\0';
+    }
+    ret = kstrtou32(val, 10, us);
+    if (ret)
+        return ret;
+    if (check_mul_overflow(*us, (u32)mult, us))
+        return -ERANGE;
+    return 0;
+}
+
+/* Parse one distribution ("200" or "p50:100,p99:50000") into *d */
+static int fs_parse_delay(char *dist, struct fs_delay *d)
+{
+    char *tok;
+    u32 q, us;
+    int ret;
+
+    memset(d, 0, sizeof(*d));
+    while ((tok = strsep(&dist, ",")) != NULL) {
+        if (!*tok)
+            continue;
+        if (d->npoints >= DELAY_POINTS - 1)
+            return -E2BIG;
+        ret = fs_parse_point(tok, &q, &us);
+        if (ret)
+            return ret;
+        /* a bare value is a fixed delay: p0:v,p100:v */
+        if (tok[0] != 'p' && d->npoints == 0) {
+            d->q[0] = 0;
+            d->us[0] = us;
+            d->npoints = 1;
+        }
+        /* quantiles and their delays must ascend: sampling interpolates */
+        if (d->npoints > 0 && (q < d->q[d->npoints - 1] ||
+                               us < d->us[d->npoints - 1]))
+            return -EINVAL;
+        d->q[d->npoints] = q;
+        d->us[d->npoints] = us;
+        d->npoints++;
+    }
+    return 0;
+}
+
+static int fs_parse_delay_spec(void)
+{
+    char *buf, *cur, *rule;
+    int i, ret = 0;
+
+    if (!delay_spec || !*delay_spec)
+        return 0;
+
+    buf = kstrdup(delay_spec, GFP_KERNEL);
+    if (!buf)
+        return -ENOMEM;
+
+    cur = buf;
+    while ((rule = strsep(&cur, ";")) != NULL) {
+        char *eq = strchr(rule, '=');
+        struct fs_delay d;
+
+        if (!*rule)
+            continue;
+        if (eq)
+            *eq = '\0';
+        ret = fs_parse_delay(eq ? eq + 1 : rule, &d);
+        if (ret) {
+            pr_err("fs_injector: bad delay_spec entry '%s'\n", rule);
+            break;
+        }
+
+        ret = -ENOENT;
+        for (i = 0; i < fs_nprobes; i++) {
+            if (eq && strcmp(fs_probes[i].symbol, rule))
+                continue;
+            fs_probes[i].delay = d;
+            ret = 0;
+        }
+        if (ret) {
+            pr_err("fs_injector: delay_spec symbol %s is not hooked\n", rule);
+            break;
+        }
+    }
+
+    kfree(buf);
+    return ret;
+}
+
+/*
+ * Per-task call counters. Every hooked call made by a targeted task gets
+ * an index (its n-th call to that symbol), which is what record/replay
+ * keys on. Tasks are numbered in order of their first hooked call, so the
+ * key (ordinal, symbol, index) is the same on every run of a
+ * deterministic workload even though PIDs differ. Only record, replay and
+ * chains need this, so other modes never take fs_task_lock.
+ *
+ * A slot is keyed by PID and start time, so a reused PID starts afresh.
+ * Lookups probe at most TASK_PROBE slots; when those are all taken, a slot
+ * whose task has exited is reclaimed.
+ */
+#define TASK_SLOTS  1024    /* power of two */
+#define TASK_PROBE  16
+
+struct fs_task {
+    pid_t pid;                  /* 0 = free slot */
+    u64   start;                /* owner's start_time */
+    int   ordinal;
+    u32   calls[MAX_PROBES];
+    u8    chain_step;           /* next chain step to fire */
+    u16   chain_hits;           /* calls failed in the current step */
+};
+
+static struct fs_task fs_tasks[TASK_SLOTS];
+static int fs_task_count;
+static DEFINE_SPINLOCK(fs_task_lock);
+
+static bool fs_task_alive(const struct fs_task *t)
+{
+    struct task_struct *tsk;
+    bool alive;
+
+    rcu_read_lock();
+    tsk = pid_task(find_pid_ns(t->pid, &init_pid_ns), PIDTYPE_PID);
+    alive = tsk && tsk->start_time == t->start;
+    rcu_read_unlock();
+    return alive;
+}
+
+/* Find or create the slot for current. Caller holds fs_task_lock. */
+static struct fs_task *fs_task_get(void)
+{
+    u32 h = hash_32(current->pid, ilog2(TASK_SLOTS));
+    struct fs_task *t, *slot = NULL;
+    int i;
+
+    for (i = 0; i < TASK_PROBE; i++) {
+        t = &fs_tasks[(h + i) & (TASK_SLOTS - 1)];
+        if (t->pid == current->pid) {
+            if (t->start == current->start_time)
+                return t;
+            slot = t;           /* the PID's previous owner has exited */
+            break;
+        }
+        if (t->pid == 0) {
+            slot = t;
+            break;
+        }
+    }
+    for (i = 0; !slot && i < TASK_PROBE; i++) {
+        t = &fs_tasks[(h + i) & (TASK_SLOTS - 1)];
+        if (!fs_task_alive(t))
+            slot = t;
+    }
+    if (!slot)
+        return NULL;
+
+    memset(slot, 0, sizeof(*slot));
+    slot->pid = current->pid;
+    slot->start = current->start_time;
+    slot->ordinal = fs_task_count++;
+    return slot;
+}
+
+/*
+ * Fault chain: declarative list of (symbol, errno, repeat) steps. Each
+ * task walks it independently; its position lives in struct fs_task and is
+ * advanced by the return handler under fs_task_lock.
+ */
+#define CHAIN_MAX  16
+
+struct fs_chain_step {
+    int probe;
+    int err;
+    int count;
+};
+
+static struct fs_chain_step fs_chain[CHAIN_MAX];
+static int fs_chain_n;
+
+/* errno for this call if it is the task's current chain step, else 0 */
+static int fs_chain_peek(struct fs_task *t, int probe)
+{
+    unsigned long flags;
+    int err = 0;
+
+    spin_lock_irqsave(&fs_task_lock, flags);
+    if (t->chain_step < fs_chain_n && fs_chain[t->chain_step].probe == probe)
+        err = fs_chain[t->chain_step].err;
+    spin_unlock_irqrestore(&fs_task_lock, flags);
+    return err;
+}
+
+/* Count one injected failure against the task's current step */
+static void fs_chain_advance(struct fs_task *t)
+{
+    unsigned long flags;
+
+    spin_lock_irqsave(&fs_task_lock, flags);
+    if (t->chain_step < fs_chain_n &&
+        ++t->chain_hits >= fs_chain[t->chain_step].count) {
+        t->chain_step++;
+        t->chain_hits = 0;
+    }
+    spin_unlock_irqrestore(&fs_task_lock, flags);
+}
+
+/*
+ * Natural-error baseline: per-CPU, per-probe counts of what the hooked
+ * calls returned on their own. One increment per call, no locks.
+ */
+struct fs_errhist {
+    u64 success;
+    u64 other;                  /* errno beyond ERRNO_SLOTS */
+    u64 err[ERRNO_SLOTS];
+    u64 injected[ERRNO_SLOTS];  /* errno-mode injections by errno */
+};
+
+static struct fs_errhist __percpu *fs_errhist;     /* [fs_nprobes] */
+
+/* A vm_fault_t as the errno its task ends up with (SIGBUS reads as EIO) */
+static long fs_vmfault_errno(long ret)
+{
+    if (ret & VM_FAULT_OOM)
+        return -ENOMEM;
+    if (ret & VM_FAULT_SIGSEGV)
+        return -EFAULT;
+    if (ret & VM_FAULT_ERROR)
+        return -EIO;
+    return 0;
+}
+
+static void fs_note_return(int probe, long ret)
+{
+    if (ret >= 0)
+        this_cpu_inc(fs_errhist[probe].success);
+    else if (-ret < ERRNO_SLOTS)
+        this_cpu_inc(fs_errhist[probe].err[-ret]);
+    else
+        this_cpu_inc(fs_errhist[probe].other);
+}
+
+/*
+ * Injection schedule: (task ordinal, symbol, call index, value). value is
+ * the errno in errno mode, the clamped length in short mode and the delay
+ * in us in delay mode. record=1 appends every injection; replay=1 injects
+ * exactly the loaded entries and nothing else.
+ */
+#define SCHED_MAX  4096
+
+struct fs_sched_ent {
+    int   ordinal;
+    int   probe;
+    u32   idx;
+    long  value;
+    pid_t tgid;                 /* informational, not part of the key */
+};
+
+static struct fs_sched_ent fs_rec[SCHED_MAX];
+static atomic_t fs_rec_n = ATOMIC_INIT(0);
+static atomic_t fs_rec_dropped = ATOMIC_INIT(0);   /* past SCHED_MAX */
+
+/* Sorted replay table, replaced wholesale on every write */
+struct fs_replay_tab {
+    struct rcu_head rcu;
+    int n;
+    struct fs_sched_ent ent[];
+};
+
+static struct fs_replay_tab __rcu *fs_replay;
+static DEFINE_MUTEX(fs_replay_lock);
+
+static int fs_sched_cmp(const void *a, const void *b)
+{
+    const struct fs_sched_ent *x = a, *y = b;
+
+    if (x->ordinal != y->ordinal)
+        return x->ordinal < y->ordinal ? -1 : 1;
+    if (x->probe != y->probe)
+        return x->probe < y->probe ? -1 : 1;
+    if (x->idx != y->idx)
+        return x->idx < y->idx ? -1 : 1;
+    return 0;
+}
+
+static void fs_sched_record(int ordinal, int probe, u32 idx, long value)
+{
+    int n = atomic_inc_return(&fs_rec_n) - 1;
+
+    if (n >= SCHED_MAX) {
+        atomic_set(&fs_rec_n, SCHED_MAX);
+        atomic_inc(&fs_rec_dropped);
+        return;
+    }
+    fs_rec[n].ordinal = ordinal;
+    fs_rec[n].probe = probe;
+    fs_rec[n].idx = idx;
+    fs_rec[n].value = value;
+    fs_rec[n].tgid = current->tgid;
+}
+
+/* Scheduled value for this call, 0 if none */
+static long fs_replay_lookup(int ordinal, int probe, u32 idx)
+{
+    struct fs_sched_ent key = { .ordinal = ordinal, .probe = probe, .idx = idx };
+    struct fs_replay_tab *tab;
+    struct fs_sched_ent *e;
+    long value = 0;
+
+    rcu_read_lock();
+    tab = rcu_dereference(fs_replay);
+    if (tab) {
+        e = bsearch(&key, tab->ent, tab->n, sizeof(key), fs_sched_cmp);
+        if (e)
+            value = e->value;
+    }
+    rcu_read_unlock();
+    return value;
+}
+
+/*
+ * Per-call state carried from the entry handler to the return handler.
+ * In short mode the length argument is clamped in the user pt_regs before
+ * the syscall reads it, so the kernel really transfers fewer bytes; the
+ * original value is put back on return since syscalls preserve argument
+ * registers.
+ */
+struct fs_call {
+    bool           match;   /* task passed the target filter at entry */
+    struct fs_task *task;   /* per-task state, NULL if the table is full */
+    int            ordinal; /* task ordinal, -1 if the task table is full */
+    int            site;    /* call-site table slot, -1 if none */
+    u32            idx;     /* per-task call index for this symbol */
+    unsigned long *arg;     /* clamped argument slot, NULL if untouched */
+    unsigned long  orig;    /* original length */
+    unsigned long  clamped; /* length the syscall actually saw */
+    bool           burst;   /* entered inside a burst window */
+    struct vm_fault *vmf;   /* vmfault probes: the handler's argument */
+    bool           vmf_ref; /* the handler takes vmf->page's reference */
+};
+
+/*
+ * A vm_fault_t may only be replaced when nothing is held for the caller:
+ * 0 or error bits. RETRY and COMPLETED mean the mmap or VMA lock was
+ * already dropped, NOPAGE and DONE_COW that the fault is resolved. A LOCKED
+ * success hands back vmf->page's folio locked; fs_fault_ret() unlocks it,
+ * and puts it too when the handler took the reference itself (->fault;
+ * ->page_mkwrite's caller owns the page it passes and drops it on error).
+ */
+static bool fs_vmfault_overridable(const struct fs_call *call,
+                                   unsigned long raw)
+{
+    raw &= ~VM_FAULT_MAJOR;
+    if (raw == VM_FAULT_LOCKED)
+        return call->vmf && call->vmf->page;
+    return !(raw & ~(VM_FAULT_ERROR | VM_FAULT_HINDEX_MASK));
+}
+
+/* Return value that makes probe p fail with errno e instead of raw */
+static long fs_fault_ret(const struct fs_probe *p, const struct fs_call *call,
+                         unsigned long raw, int e)
+{
+    if (!p->vmfault)
+        return -e;
+    if (raw & VM_FAULT_LOCKED) {
+        struct folio *folio = page_folio(call->vmf->page);
+
+        folio_unlock(folio);
+        if (call->vmf_ref)
+            folio_put(folio);
+    }
+    return e == ENOMEM ? VM_FAULT_OOM : VM_FAULT_SIGBUS;
+}
+
+/*
+ * __x64_sys_* wrappers take the user pt_regs as their only argument;
+ * return the slot holding syscall argument n (x86_64 calling convention).
+ */
+static unsigned long *fs_syscall_arg(struct pt_regs *regs, int n)
+{
+    struct pt_regs *uregs = (struct pt_regs *)regs->di;
+
+    switch (n) {
+    case 0: return &uregs->di;
+    case 1: return &uregs->si;
+    case 2: return &uregs->dx;
+    case 3: return &uregs->r10;
+    case 4: return &uregs->r8;
+    case 5: return &uregs->r9;
+    default: return NULL;
+    }
+}
+
+/*
+ * Path-prefix filter. The prefixes are compiled into a byte trie stored as
+ * a flat array (first-child / next-sibling links); a path matches when it
+ * runs through a terminal node at a component boundary, so "/a/b" matches
+ * "/a/b" and "/a/b/c" but not "/a/bc". Relative names are resolved
+ * against the dirfd or cwd with d_path(). Paths longer than
+ * FS_PATH_MAX, unreadable user strings and names with ".." never match.
+ */
+#define TRIE_MAX     1024
+#define FS_PATH_MAX  512
+
+struct fs_trie_node {
+    u16  child;     /* first child, 0 = none (node 0 is the root) */
+    u16  sibling;   /* next sibling, 0 = none */
+    char ch;
+    bool terminal;
+};
+
+static struct fs_trie_node fs_trie[TRIE_MAX];
+static int fs_trie_n = 1;           /* node 0 = root */
+static bool fs_path_filter;         /* any prefix loaded */
+
+struct fs_path_buf {
+    char name[FS_PATH_MAX];
+    char dir[FS_PATH_MAX];
+};
+static DEFINE_PER_CPU(struct fs_path_buf, fs_path_bufs);
+
+static int fs_trie_insert(const char *prefix)
+{
+    size_t len = strlen(prefix);
+    int node = 0;
+    size_t i;
+
+    /* "/a/b/" and "/a/b" are the same prefix */
+    while (len > 1 && prefix[len - 1] == '/')
+        len--;
+    if (len == 0 || prefix[0] != '/')
+        return -EINVAL;
+
+    for (i = 0; i < len; i++) {
+        int c = fs_trie[node].child;
+
+        while (c && fs_trie[c].ch != prefix[i])
+            c = fs_trie[c].sibling;
+        if (!c) {
+            if (fs_trie_n >= TRIE_MAX)
+                return -E2BIG;
+            c = fs_trie_n++;
+            fs_trie[c].ch = prefix[i];
+            fs_trie[c].sibling = fs_trie[node].child;
+            fs_trie[node].child = c;
+        }
+        node = c;
+    }
+    fs_trie[node].terminal = true;
+    return 0;
+}
+
+struct fs_trie_cursor {
+    int  node;
+    bool matched;
+    bool dead;
+};
+
+/* Advance the cursor over s; stops early once the outcome is known */
+static void fs_trie_feed(struct fs_trie_cursor *cur, const char *s)
+{
+    for (; *s && !cur->matched && !cur->dead; s++) {
+        int c;
+
+        if (*s == '/' && fs_trie[cur->node].terminal) {
+            cur->matched = true;
+            return;
+        }
+        c = fs_trie[cur->node].child;
+        while (c && fs_trie[c].ch != *s)
+            c = fs_trie[c].sibling;
+        if (!c)
+            cur->dead = true;
+        else
+            cur->node = c;
+    }
+}
+
+static bool fs_trie_matched(const struct fs_trie_cursor *cur)
+{
+    return cur->matched || (!cur->dead && fs_trie[cur->node].terminal);
+}
+
+static int fs_load_prefixes(void)
+{
+    char *buf, *cur, *prefix;
+    int ret = 0;
+
+    if (!path_prefixes || !*path_prefixes)
+        return 0;
+
+    buf = kstrdup(path_prefixes, GFP_KERNEL);
+    if (!buf)
+        return -ENOMEM;
+
+    cur = buf;
+    while ((prefix = strsep(&cur, ",")) != NULL) {
+        if (!*prefix)
+            continue;
+        ret = fs_trie_insert(prefix);
+        if (ret) {
+            pr_err("fs_injector: bad path prefix '%s': %d\n", prefix, ret);
+            break;
+        }
+        fs_path_filter = true;
+    }
+
+    kfree(buf);
+    return ret;
+}
+
+/* "d0p1" -> dirfd 0, path 1; "f0" -> fd 0 */
+static int fs_parse_argspec(const char *spec, struct fs_probe *p)
+{
+    for (; *spec; spec += 2) {
+        int n;
+
+        if (spec[1] < '0' || spec[1] > '5')
+            return -EINVAL;
+        n = spec[1] - '0';
+        switch (spec[0]) {
+        case 'p': p->path_arg = n; break;
+        case 'd': p->dirfd_arg = n; break;
+        case 'f': p->fd_arg = n; break;
+        default: return -EINVAL;
+        }
+    }
+    return 0;
+}
+
+static int fs_parse_path_spec(void)
+{
+    char *buf, *cur, *rule;
+    int i, ret = 0;
+
+    if (!path_spec || !*path_spec)
+        return 0;
+
+    buf = kstrdup(path_spec, GFP_KERNEL);
+    if (!buf)
+        return -ENOMEM;
+
+    cur = buf;
+    while ((rule = strsep(&cur, ";")) != NULL) {
+        char *eq = strchr(rule, '=');
+
+        if (!*rule)
+            continue;
+        if (!eq) {
+            ret = -EINVAL;
+            break;
+        }
+        *eq = '\0';
+        ret = -ENOENT;
+        for (i = 0; i < fs_nprobes; i++) {
+            if (strcmp(fs_probes[i].symbol, rule))
+                continue;
+            ret = fs_parse_argspec(eq + 1, &fs_probes[i]);
+            break;
+        }
+        if (ret) {
+            pr_err("fs_injector: bad path_spec entry for %s: %d\n", rule, ret);
+            break;
+        }
+    }
+
+    kfree(buf);
+    return ret;
+}
+
+static int fs_parse_errno_allow(void)
+{
+    char *buf, *cur, *rule;
+    int i, ret = 0;
+
+    if (!errno_allow || !*errno_allow)
+        return 0;
+
+    buf = kstrdup(errno_allow, GFP_KERNEL);
+    if (!buf)
+        return -ENOMEM;
+
+    cur = buf;
+    while ((rule = strsep(&cur, ";")) != NULL) {
+        char *eq = strchr(rule, '=');
+
+        if (!*rule)
+            continue;
+        if (!eq) {
+            ret = -EINVAL;
+            break;
+        }
+        *eq = '\0';
+        ret = -ENOENT;
+        for (i = 0; i < fs_nprobes; i++) {
+            struct fs_probe *p = &fs_probes[i];
+
+            if (strcmp(p->symbol, rule))
+                continue;
+            ret = bitmap_parse(eq + 1, strlen(eq + 1), p->errno_allow,
+                               ERRNO_SLOTS);
+            p->errno_check = !ret;
+            break;
+        }
+        if (ret) {
+            pr_err("fs_injector: bad errno_allow entry for %s: %d\n",
+                   rule, ret);
+            break;
+        }
+    }
+
+    kfree(buf);
+    return ret;
+}
+
+static bool fs_errno_ok(const struct fs_probe *p, int e)
+{
+    return !p->errno_check || (e < ERRNO_SLOTS && test_bit(e, p->errno_allow));
+}
+
+static void fs_errno_reject(void)
+{
+    atomic_inc(&errno_rejects_atomic);
+    errno_rejects = atomic_read(&errno_rejects_atomic);
+}
+
+/* Chain, burst and replay errnos: tested per call; a miss is counted, not made */
+static bool fs_errno_allowed(const struct fs_probe *p, int e)
+{
+    if (fs_errno_ok(p, e))
+        return true;
+    fs_errno_reject();
+    return false;
+}
+
+/*
+ * inject_errno is tested when it is set rather than on every call: each
+ * probe keeps the errno it may inject (0 if the allowlist drops it), and
+ * one reject is counted per dropped setting. Runs under kernel_param_lock.
+ */
+static bool fs_allow_ready;     /* probes and bitmaps are set up */
+
+static void fs_inject_errno_update(void)
+{
+    int i, e = READ_ONCE(inject_errno);
+    bool dropped = false;
+
+    for (i = 0; i < fs_nprobes; i++) {
+        struct fs_probe *p = &fs_probes[i];
+        bool ok = e > 0 && fs_errno_ok(p, e);
+
+        dropped |= e > 0 && !ok;
+        WRITE_ONCE(p->inject_err, ok ? e : 0);
+    }
+    if (dropped) {
+        pr_warn("fs_injector: inject_errno=%d is not allowed for some "
+                "hooked symbols\n", e);
+        fs_errno_reject();
+    }
+}
+
+static int fs_inject_errno_set(const char *val, const struct kernel_param *kp)
+{
+    int ret = param_set_int(val, kp);
+
+    /* while loading, init does this once the bitmaps are parsed */
+    if (!ret && fs_allow_ready)
+        fs_inject_errno_update();
+    return ret;
+}
+
+static const struct kernel_param_ops fs_inject_errno_ops = {
+    .set = fs_inject_errno_set,
+    .get = param_get_int,
+};
+
+module_param_cb(inject_errno, &fs_inject_errno_ops, &inject_errno, 0644);
+MODULE_PARM_DESC(inject_errno,
+                 "Errno number to inject (positive). Will use -errno as return value.");
+
+/* d_path() of an open fd into buf; NULL on failure */
+static char *fs_fd_path(int fd, char *buf)
+{
+    struct file *f = fget_raw(fd);
+    char *path;
+
+    if (!f)
+        return NULL;
+    path = d_path(&f->f_path, buf, FS_PATH_MAX);
+    fput(f);
+    return IS_ERR(path) ? NULL : path;
+}
+
+static char *fs_cwd_path(char *buf)
+{
+    struct fs_struct *fs = current->fs;
+    char *path;
+
+    if (!fs)
+        return NULL;
+    spin_lock(&fs->lock);
+    path = d_path(&fs->pwd, buf, FS_PATH_MAX);
+    spin_unlock(&fs->lock);
+    return IS_ERR(path) ? NULL : path;
+}
+
+/* Does this call's path (or fd's path) lie under a configured prefix? */
+static bool fs_path_match(struct fs_probe *p, struct pt_regs *regs)
+{
+    struct fs_path_buf *b;
+    struct fs_trie_cursor cur = { 0 };
+    unsigned long *arg;
+    char *dir = NULL;
+    long n;
+
+    if (!fs_path_filter || (p->path_arg < 0 && p->fd_arg < 0))
+        return true;
+
+    b = this_cpu_ptr(&fs_path_bufs);
+
+    if (p->path_arg < 0) {
+        dir = fs_fd_path((int)*fs_syscall_arg(regs, p->fd_arg), b->dir);
+        if (!dir)
+            return false;
+        fs_trie_feed(&cur, dir);
+        return fs_trie_matched(&cur);
+    }
+
+    arg = fs_syscall_arg(regs, p->path_arg);
+    n = strncpy_from_user_nofault(b->name, (const char __user *)*arg,
+                                  FS_PATH_MAX);
+    if (n <= 0 || n >= FS_PATH_MAX)
+        return false;
+    if (strstr(b->name, ".."))
+        return false;
+
+    if (b->name[0] != '/') {
+        int dfd = AT_FDCWD;
+
+        if (p->dirfd_arg >= 0)
+            dfd = (int)*fs_syscall_arg(regs, p->dirfd_arg);
+        dir = dfd == AT_FDCWD ? fs_cwd_path(b->dir) : fs_fd_path(dfd, b->dir);
+        if (!dir)
+            return false;
+        fs_trie_feed(&cur, dir);
+        fs_trie_feed(&cur, "/");
+    }
+    fs_trie_feed(&cur, b->name);
+    return fs_trie_matched(&cur);
+}
+
+/* Is current in one of the target cgroups, or below one? */
+static bool fs_cgroup_match(void)
+{
+    const struct fs_id_set *set;
+    struct cgroup *cgrp;
+    bool hit = false;
+    int i;
+
+    rcu_read_lock();
+    set = rcu_dereference(fs_cgroups);
+    if (!set) {
+        rcu_read_unlock();
+        return true;
+    }
+    for (cgrp = task_dfl_cgroup(current); cgrp && !hit;
+         cgrp = cgroup_parent(cgrp)) {
+        u64 id = cgroup_id(cgrp);
+
+        for (i = 0; i < set->n; i++) {
+            if (set->ids[i] == id) {
+                hit = true;
+                break;
+            }
+        }
+    }
+    rcu_read_unlock();
+    return hit;
+}
+
+/*
+ * Call-site fingerprint: the syscall's user return address followed by the
+ * return addresses of a frame-pointer walk of the user stack. Addresses are
+ * hashed raw, so fingerprints are stable for one address-space layout;
+ * start the target without ASLR to compare them across runs.
+ */
+#define CALLSITE_FRAMES  8
+#define SITE_SLOTS       256
+
+struct fs_site {
+    u64 fp;                     /* 0 = free slot */
+    u8  probe;
+    u8  nframes;
+    u32 hits;
+    u32 injected;
+    unsigned long frames[CALLSITE_FRAMES];
+};
+
+static struct fs_site fs_sites[SITE_SLOTS];
+static DEFINE_SPINLOCK(fs_site_lock);
+
+static int fs_user_frames(unsigned long *frames, int max)
+{
+    struct pt_regs *uregs = task_pt_regs(current);
+    unsigned long bp = uregs->bp;
+    int n = 0;
+
+    frames[n++] = instruction_pointer(uregs);
+    while (n < max && bp) {
+        unsigned long frame[2];         /* saved bp, return address */
+
+        if (copy_from_user_nofault(frame, (void __user *)bp, sizeof(frame)))
+            break;
+        if (!frame[1])
+            break;
+        frames[n++] = frame[1];
+        /* callers' frames live higher up; anything else is not a frame */
+        if (frame[0] <= bp)
+            break;
+        bp = frame[0];
+    }
+    return n;
+}
+
+/* Count a hit at fp; slot index, or -1 if the table is full */
+static int fs_site_hit(u64 fp, int probe, const unsigned long *frames, int n)
+{
+    u32 h = hash_64(fp, ilog2(SITE_SLOTS));
+    unsigned long flags;
+    int i, slot = -1;
+
+    spin_lock_irqsave(&fs_site_lock, flags);
+    for (i = 0; i < SITE_SLOTS; i++) {
+        struct fs_site *site = &fs_sites[(h + i) & (SITE_SLOTS - 1)];
+
+        if (site->fp == 0) {
+            site->fp = fp;
+            site->probe = probe;
+            site->nframes = n;
+            memcpy(site->frames, frames, n * sizeof(frames[0]));
+        }
+        if (site->fp == fp) {
+            site->hits++;
+            slot = site - fs_sites;
+            break;
+        }
+    }
+    spin_unlock_irqrestore(&fs_site_lock, flags);
+    return slot;
+}
+
+/* Fingerprint current's call site, count it, and check target_callsites */
+static bool fs_callsite_match(struct fs_probe *p, struct fs_call *call)
+{
+    unsigned long frames[CALLSITE_FRAMES];
+    const struct fs_id_set *set;
+    bool hit = false;
+    u64 fp = 0;
+    int i, n;
+
+    n = fs_user_frames(frames, callsite_depth);
+    for (i = 0; i < n; i++)
+        fp = rol64((fp ^ frames[i]) * GOLDEN_RATIO_64, 29);
+    if (!fp)
+        fp = 1;
+
+    call->site = fs_site_hit(fp, p - fs_probes, frames, n);
+
+    rcu_read_lock();
+    set = rcu_dereference(fs_callsites);
+    if (!set)
+        hit = true;
+    for (i = 0; set && i < set->n && !hit; i++)
+        hit = set->ids[i] == fp;
+    rcu_read_unlock();
+    return hit;
+}
+
+/* PID / comm / cgroup filter */
+static bool fs_task_match(void)
+{
+    if (target_pid > 0 && current->pid != target_pid)
+        return false;
+
+    if (target_comm && *target_comm &&
+        strncmp(current->comm, target_comm, TASK_COMM_LEN))
+        return false;
+
+    return fs_cgroup_match();
+}
+
+/* Injection budget (ignored in replay, where the schedule is the budget) */
+static bool fs_budget_left(void)
+{
+    return atomic_read(&injections_done_atomic) < max_injections;
+}
+
+/* Is now inside a burst window? */
+static bool fs_burst_active(u64 now)
+{
+    const struct fs_burst_win *w;
+    bool on = false;
+
+    rcu_read_lock();
+    w = rcu_dereference(fs_burst);
+    if (w && now >= w->start) {
+        u64 off = now - w->start;
+
+        if (w->period)
+            div64_u64_rem(off, w->period, &off);
+        on = off < w->len;
+    }
+    rcu_read_unlock();
+    return on;
+}
+
+/* Rate: only every Nth eligible call is overridden */
+static bool fs_rate_hit(void)
+{
+    return inject_every <= 1 ||
+           atomic_inc_return(&eligible_calls) % inject_every == 0;
+}
+
+static void fs_log_injection(struct fs_probe *p, struct fs_call *call,
+                             long old_ret, long new_ret, u32 delay_us,
+                             long value)
+{
+    /* Timestamp in ns */
+    ktime_t kt = ktime_get_real();
+    s64 ts_ns = ktime_to_ns(kt);
+
+    pr_info("fs_injector: inj_id=%d pid=%d comm=%s "
+            "symbol=%s old_ret=%ld new_ret=%ld ts_ns=%lld unsafe=%d mode=%d "
+            "delay_us=%u task=%d call_idx=%u\n",
+            atomic_read(&inj_id), current->pid, current->comm,
+            p->symbol, old_ret, new_ret, ts_ns, unsafe_mode, fault_mode,
+            delay_us, call->ordinal, call->idx);
+
+    if (record && call->ordinal >= 0)
+        fs_sched_record(call->ordinal, p - fs_probes, call->idx, value);
+
+    if (call->site >= 0) {
+        unsigned long flags;
+
+        spin_lock_irqsave(&fs_site_lock, flags);
+        fs_sites[call->site].injected++;
+        spin_unlock_irqrestore(&fs_site_lock, flags);
+    }
+
+    if (fault_mode == FAULT_ERRNO && value > 0 && value < ERRNO_SLOTS)
+        this_cpu_inc(fs_errhist[p - fs_probes].injected[value]);
+
+    atomic_inc(&inj_id);
+    atomic_inc(&injections_done_atomic);
+    injections_done = atomic_read(&injections_done_atomic);
+}
+
+/* Clamp the length argument to len; false if there is nothing to shorten */
+static bool fs_clamp_arg(struct fs_call *call, struct pt_regs *regs,
+                         unsigned long len)
+{
+    unsigned long *slot = fs_syscall_arg(regs, count_arg);
+
+    if (!slot || len < 1 || len >= *slot)
+        return false;
+
+    call->arg = slot;
+    call->orig = *slot;
+    call->clamped = len;
+    *slot = len;
+    return true;
+}
+
+/*
+ * kretprobe entry handler: assigns the per-task call index and clamps the
+ * length argument in short mode
  */
+static int fs_entry_handler(struct kretprobe_instance *ri, struct pt_regs *regs)
+{
+    struct fs_call *call = (struct fs_call *)ri->data;
+    struct fs_probe *p = fs_probe_of(ri);
+    struct fs_task *t;
+    unsigned long flags;
+    unsigned long *slot;
+    unsigned long len;
 
-static char *target_symbol = "__x64_sys_readlink";
-module_param(target_symbol, charp, 0644);
-MODULE_PARM_DESC(target_symbol,
-                 "Kernel symbol name to hook (e.g., \"__x64_sys_readlink\")");
+    call->arg = NULL;
+    call->task = NULL;
+    call->ordinal = -1;
+    call->site = -1;
+    call->idx = 0;
+    call->burst = false;
+    call->vmf = NULL;
+    call->match = fs_task_match();
+    if (!call->match)
+        return 0;
 
-static int target_pid = 0;
-module_param(target_pid, int, 0644);
-MODULE_PARM_DESC(target_pid, "PID to target. 0 = all tasks");
+    /* Only record/replay and chains need call indices */
+    if (fault_mode != FAULT_OBSERVE && (record || replay || fs_chain_n)) {
+        spin_lock_irqsave(&fs_task_lock, flags);
+        t = fs_task_get();
+        if (t) {
+            call->task = t;
+            call->ordinal = t->ordinal;
+            call->idx = t->calls[p - fs_probes]++;
+        }
+        spin_unlock_irqrestore(&fs_task_lock, flags);
+    }
 
-static int inject_errno = 13;   // default: EACCES
-module_param(inject_errno, int, 0644);
-MODULE_PARM_DESC(inject_errno,
-                 "Errno number to inject (positive). Will use -errno as return value.");
+    if (!fs_path_match(p, regs)) {
+        call->match = false;
+        atomic_inc(&path_rejects_atomic);
+        path_rejects = atomic_read(&path_rejects_atomic);
+        return 0;
+    }
 
-static int max_injections = 1;
-module_param(max_injections, int, 0644);
-MODULE_PARM_DESC(max_injections,
-                 "Number of injections allowed before auto-stop");
+    if (callsite_depth > 0 && !fs_callsite_match(p, call)) {
+        call->match = false;
+        atomic_inc(&callsite_rejects);
+        return 0;
+    }
 
-static int unsafe_mode = 1;
-module_param(unsafe_mode, int, 0644);
-MODULE_PARM_DESC(unsafe_mode,
-                 "0 = only modify failing calls; 1 = allow overriding successful calls too");
+    /* ->fault sets vmf->page itself, ->page_mkwrite is passed one */
+    if (p->vmfault) {
+        call->vmf = (struct vm_fault *)regs_get_kernel_argument(regs, 0);
+        call->vmf_ref = !call->vmf->page;
+    }
 
-/* Expose injections_done via sysfs as read-only int */
-static atomic_t injections_done_atomic = ATOMIC_INIT(0);
-static int injections_done;
-module_param(injections_done, int, 0444);
-MODULE_PARM_DESC(injections_done, "Total number of injections performed (read-only)");
+    /* Decided at entry: a call issued during the outage fails even if it
+     * returns after the window has closed. No clock read while unarmed. */
+    if (fault_mode == FAULT_ERRNO && p->burst_errno &&
+        rcu_access_pointer(fs_burst))
+        call->burst = fs_burst_active(ktime_get_ns());
 
-static atomic_t inj_id = ATOMIC_INIT(0);
+    if (fault_mode != FAULT_SHORT)
+        return 0;
+
+    if (replay) {
+        len = fs_replay_lookup(call->ordinal, p - fs_probes, call->idx);
+        if (len > 0)
+            fs_clamp_arg(call, regs, len);
+        return 0;
+    }
+
+    if (!fs_budget_left())
+        return 0;
+
+    slot = fs_syscall_arg(regs, count_arg);
+    if (!slot)
+        return 0;
+
+    /* Nothing to shorten below two bytes */
+    if (*slot <= 1)
+        return 0;
+
+    len = *slot * short_pct / 100;
+    if (short_cap > 0 && len > short_cap)
+        len = short_cap;
+    if (len < 1)
+        len = 1;
+    if (len >= *slot)
+        return 0;
+
+    if (!fs_rate_hit())
+        return 0;
+
+    fs_clamp_arg(call, regs, len);
+
+    return 0;
+}
 
 /* kretprobe handler for target_symbol */
 static int fs_ret_handler(struct kretprobe_instance *ri, struct pt_regs *regs)
 {
-    pid_t pid = current->pid;
+    struct fs_call *call = (struct fs_call *)ri->data;
+    struct fs_probe *p = fs_probe_of(ri);
     long old_ret = regs->ax;
     long new_ret;
+    int err;
+
+    if (!call->match)
+        return 0;
+
+    /* Histogram and safe mode both look at the errno the task will see */
+    if (p->vmfault)
+        old_ret = fs_vmfault_errno(old_ret);
+
+    if (fault_mode != FAULT_SHORT)
+        fs_note_return(p - fs_probes, old_ret);
+
+    if (fault_mode == FAULT_OBSERVE)
+        return 0;
+
+    if (fault_mode == FAULT_SHORT) {
+        /* The clamped call's result is not natural; only count the rest */
+        if (!call->arg) {
+            fs_note_return(p - fs_probes, old_ret);
+            return 0;
+        }
+
+        *call->arg = call->orig;
+
+        /* Only a successful transfer counts as a short-count injection */
+        if (old_ret > 0)
+            fs_log_injection(p, call, (long)call->orig, old_ret, 0,
+                             (long)call->clamped);
+        return 0;
+    }
 
-    /* PID filter */
-    if (target_pid > 0 && pid != target_pid)
+    if (fault_mode == FAULT_DELAY) {
+        u32 us;
+
+        if (replay)
+            us = fs_replay_lookup(call->ordinal, p - fs_probes, call->idx);
+        else if (!fs_budget_left() || !fs_rate_hit())
+            return 0;
+        else
+            us = fs_delay_sample(&p->delay);
+        if (us == 0 || !fs_apply_delay(us))
+            return 0;
+        fs_log_injection(p, call, old_ret, old_ret, us, us);
+        return 0;
+    }
+
+    /* A vm_fault_t still holding locks for the caller is left alone */
+    if (p->vmfault && !fs_vmfault_overridable(call, regs->ax))
+        return 0;
+
+    if (call->burst) {
+        if ((!unsafe_mode && old_ret >= 0) ||
+            !fs_errno_allowed(p, p->burst_errno))
+            return 0;
+        new_ret = fs_fault_ret(p, call, regs->ax, p->burst_errno);
+        fs_log_injection(p, call, old_ret, new_ret, 0, p->burst_errno);
+        atomic_inc(&burst_injections_atomic);
+        burst_injections = atomic_read(&burst_injections_atomic);
+        regs->ax = new_ret;
+        return 0;
+    }
+
+    if (fs_chain_n) {
+        int e = call->task ? fs_chain_peek(call->task, p - fs_probes) : 0;
+
+        /* a call that is not failed does not use up the step */
+        if (e <= 0 || (!unsafe_mode && old_ret >= 0) ||
+            !fs_errno_allowed(p, e))
+            return 0;
+        fs_chain_advance(call->task);
+        new_ret = fs_fault_ret(p, call, regs->ax, e);
+        fs_log_injection(p, call, old_ret, new_ret, 0, e);
+        regs->ax = new_ret;
+        return 0;
+    }
+
+    if (replay) {
+        long e = fs_replay_lookup(call->ordinal, p - fs_probes, call->idx);
+
+        if (e <= 0 || (!unsafe_mode && old_ret >= 0) ||
+            !fs_errno_allowed(p, e))
+            return 0;
+        new_ret = fs_fault_ret(p, call, regs->ax, e);
+        fs_log_injection(p, call, old_ret, new_ret, 0, e);
+        regs->ax = new_ret;
         return 0;
+    }
 
-    /* Injection limit */
-    if (atomic_read(&injections_done_atomic) >= max_injections)
+    if (!fs_budget_left())
         return 0;
 
     /* Safe mode: only override already-failing calls (old_ret < 0) */
     if (!unsafe_mode && old_ret >= 0)
         return 0;
 
-    if (inject_errno <= 0)
+    /* 0 when off or dropped by errno_allow: no Nth call is used up */
+    err = READ_ONCE(p->inject_err);
+    if (err <= 0)
         return 0;
 
-    new_ret = -inject_errno;
+    if (!fs_rate_hit())
+        return 0;
 
-    /* Timestamp in ns */
-    {
-        ktime_t kt = ktime_get_real();
-        s64 ts_ns = ktime_to_ns(kt);
+    new_ret = fs_fault_ret(p, call, regs->ax, err);
 
-        pr_info("fs_injector: inj_id=%d pid=%d comm=%s "
-                "symbol=%s old_ret=%ld new_ret=%ld ts_ns=%lld unsafe=%d\n",
-                atomic_read(&inj_id), pid, current->comm,
-                target_symbol ? target_symbol : "(null)",
-                old_ret, new_ret, ts_ns, unsafe_mode);
-    }
+    fs_log_injection(p, call, old_ret, new_ret, 0, err);
 
     regs->ax = new_ret;
 
-    atomic_inc(&inj_id);
-    atomic_inc(&injections_done_atomic);
-    injections_done = atomic_read(&injections_done_atomic);
+    return 0;
+}
+
+/* ---- debugfs: fs_injector/schedule ---- */
+
+static struct dentry *fs_debugfs_dir;
+
+/*
+ * Read: "# header" then "ordinal symbol call_idx value tgid" per injection.
+ * symbols= lists every hooked probe, chain and burst ones included, so a
+ * replay hooks them all; dropped= counts injections that did not fit.
+ */
+static int fs_schedule_show(struct seq_file *m, void *v)
+{
+    int i, n = atomic_read(&fs_rec_n);
+
+    seq_printf(m, "# fault_mode=%d symbols=", fault_mode);
+    for (i = 0; i < fs_nprobes; i++)
+        seq_printf(m, "%s%s", i ? "," : "", fs_probes[i].symbol);
+    seq_printf(m, " dropped=%d\n", atomic_read(&fs_rec_dropped));
+    for (i = 0; i < n && i < SCHED_MAX; i++)
+        seq_printf(m, "%d %s %u %ld %d\n",
+                   fs_rec[i].ordinal, fs_probes[fs_rec[i].probe].symbol,
+                   fs_rec[i].idx, fs_rec[i].value, fs_rec[i].tgid);
+    return 0;
+}
+
+static int fs_schedule_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, fs_schedule_show, NULL);
+}
+
+static int fs_probe_index(const char *symbol)
+{
+    int i;
+
+    for (i = 0; i < fs_nprobes; i++)
+        if (!strcmp(fs_probes[i].symbol, symbol))
+            return i;
+    return -1;
+}
+
+/*
+ * Write: whole lines of "ordinal symbol call_idx value [tgid]" are added
+ * to the replay table; "clear" empties it. Load before the target starts.
+ * Each write publishes a new table, so handlers never see one being sorted;
+ * a write with a bad line publishes nothing. Batch lines (up to a page per
+ * write): every write copies and re-sorts the whole table.
+ */
+static ssize_t fs_schedule_write(struct file *file, const char __user *ubuf,
+                                 size_t len, loff_t *ppos)
+{
+    struct fs_replay_tab *old, *tab;
+    char *buf, *cur, *line;
+    int n, cap, ret = 0;
+
+    if (len >= PAGE_SIZE)
+        return -E2BIG;
+
+    buf = memdup_user_nul(ubuf, len);
+    if (IS_ERR(buf))
+        return PTR_ERR(buf);
+
+    mutex_lock(&fs_replay_lock);
+    old = rcu_dereference_protected(fs_replay,
+                                    lockdep_is_held(&fs_replay_lock));
+    n = old ? old->n : 0;
+    /* at most one entry per line */
+    cap = n + 1;
+    for (cur = buf; *cur; cur++)
+        cap += *cur == '\n';
+    cap = min(cap, SCHED_MAX);
+    tab = kvmalloc(struct_size(tab, ent, cap), GFP_KERNEL);
+    if (!tab) {
+        mutex_unlock(&fs_replay_lock);
+        kfree(buf);
+        return -ENOMEM;
+    }
+    if (n)
+        memcpy(tab->ent, old->ent, n * sizeof(tab->ent[0]));
+
+    cur = buf;
+    while ((line = strsep(&cur, "\n")) != NULL) {
+        char sym[128];
+        struct fs_sched_ent *e;
+        int probe;
 
+        line = strim(line);
+        if (!*line || *line == '#')
+            continue;
+        if (!strcmp(line, "clear")) {
+            n = 0;
+            continue;
+        }
+        if (n >= cap) {
+            ret = -ENOSPC;
+            break;
+        }
+        e = &tab->ent[n];
+        if (sscanf(line, "%d %127s %u %ld", &e->ordinal, sym,
+                   &e->idx, &e->value) != 4) {
+            ret = -EINVAL;
+            break;
+        }
+        probe = fs_probe_index(sym);
+        if (probe < 0) {
+            pr_err("fs_injector: schedule symbol %s is not hooked\n", sym);
+            ret = -ENOENT;
+            break;
+        }
+        e->probe = probe;
+        e->tgid = 0;
+        n++;
+    }
+
+    if (ret) {
+        mutex_unlock(&fs_replay_lock);
+        kvfree(tab);
+        kfree(buf);
+        return ret;
+    }
+    sort(tab->ent, n, sizeof(tab->ent[0]), fs_sched_cmp, NULL);
+    tab->n = n;
+    rcu_assign_pointer(fs_replay, tab);
+    mutex_unlock(&fs_replay_lock);
+    if (old)
+        kvfree_rcu(old, rcu);
+
+    kfree(buf);
+    return len;
+}
+
+static const struct file_operations fs_schedule_fops = {
+    .owner   = THIS_MODULE,
+    .open    = fs_schedule_open,
+    .read    = seq_read,
+    .llseek  = seq_lseek,
+    .release = single_release,
+    .write   = fs_schedule_write,
+};
+
+/* ---- debugfs: fs_injector/errors ---- */
+
+/*
+ * Read: "symbol calls=N success=N errno:count ... [other:N]" per symbol,
+ * summed over CPUs. Write "reset" to clear.
+ */
+static int fs_errors_show(struct seq_file *m, void *v)
+{
+    int i, e, cpu;
+
+    seq_printf(m, "# fault_mode=%d\n", fault_mode);
+    for (i = 0; i < fs_nprobes; i++) {
+        u64 success = 0, other = 0, errors = 0;
+
+        for_each_possible_cpu(cpu) {
+            const struct fs_errhist *h = per_cpu_ptr(fs_errhist, cpu) + i;
+
+            success += h->success;
+            other += h->other;
+            for (e = 1; e < ERRNO_SLOTS; e++)
+                errors += h->err[e];
+        }
+
+        seq_printf(m, "%s calls=%llu success=%llu", fs_probes[i].symbol,
+                   success + errors + other, success);
+        for (e = 1; e < ERRNO_SLOTS; e++) {
+            u64 n = 0;
+
+            for_each_possible_cpu(cpu)
+                n += (per_cpu_ptr(fs_errhist, cpu) + i)->err[e];
+            if (n)
+                seq_printf(m, " %d:%llu", e, n);
+        }
+        if (other)
+            seq_printf(m, " other:%llu", other);
+        seq_putc(m, '\n');
+    }
     return 0;
 }
 
-static struct kretprobe fs_kretprobe = {
-    .handler = fs_ret_handler,
-    .maxactive = 20,
-    .kp.symbol_name = NULL,   // filled at init
+static int fs_errors_open(struct inode *inode, struct file *file)
+{
+    return single_open(file, fs_errors_show, NULL);
+}
+
+static ssize_t fs_errors_write(struct file *file, const char __user *ubuf,
+                               size_t len, loff_t *ppos)
+{
+    char buf[8];
+    int cpu;
+
+    if (len >= sizeof(buf))
+        return -EINVAL;
+    if (copy_from_user(buf, ubuf, len))
+        return -EFAULT;
+    buf[len] = '\0';
+    if (strcmp(strim(buf), "reset"))
+        return -EINVAL;
+
+    /* Racy against in-flight increments; good enough for a baseline */
+    for_each_possible_cpu(cpu)
+        memset(per_cpu_ptr(fs_errhist, cpu), 0,
+               sizeof(struct fs_errhist) * fs_nprobes);
+    return len;
+}
+
+static const struct file_operations fs_errors_fops = {
+    .owner   = THIS_MODULE,
+    .open    = fs_errors_open,
+    .read    = seq_read,
+    .llseek  = seq_lseek,
+    .release = single_release,
+    .write   = fs_errors_write,
 };
 
-static int __init fs_injector_init(void)
+/* ---- debugfs: fs_injector/callsites ---- */
+
+/* "fingerprint symbol hits injected frame..." per call site seen */
+static int fs_callsites_show(struct seq_file *m, void *v)
+{
+    struct fs_site site;
+    unsigned long flags;
+    int i, j;
+
+    seq_printf(m, "# callsite_depth=%d\n", callsite_depth);
+    for (i = 0; i < SITE_SLOTS; i++) {
+        spin_lock_irqsave(&fs_site_lock, flags);
+        site = fs_sites[i];
+        spin_unlock_irqrestore(&fs_site_lock, flags);
+        if (!site.fp)
+            continue;
+
+        seq_printf(m, "0x%016llx %s %u %u", site.fp,
+                   fs_probes[site.probe].symbol, site.hits, site.injected);
+        for (j = 0; j < site.nframes; j++)
+            seq_printf(m, " %lx", site.frames[j]);
+        seq_putc(m, '\n');
+    }
+    return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(fs_callsites);
+
+/* ---- debugfs: fs_injector/metrics ---- */
+
+/* Sum over CPUs of one counter: success (e = 0), err[e] or injected[e] */
+static u64 fs_errhist_sum(int probe, int e, bool injected)
+{
+    u64 n = 0;
+    int cpu;
+
+    for_each_possible_cpu(cpu) {
+        const struct fs_errhist *h = per_cpu_ptr(fs_errhist, cpu) + probe;
+
+        n += injected ? h->injected[e] : e ? h->err[e] : h->success;
+    }
+    return n;
+}
+
+/* Prometheus text format; summed on read, so the handlers stay per-CPU */
+static int fs_metrics_show(struct seq_file *m, void *v)
+{
+    int i, e;
+
+    seq_puts(m, "# TYPE fs_injector_injections_total counter\n");
+    seq_printf(m, "fs_injector_injections_total %d\n",
+               atomic_read(&injections_done_atomic));
+    seq_puts(m, "# TYPE fs_injector_rejects_total counter\n");
+    seq_printf(m, "fs_injector_rejects_total{filter=\"path\"} %d\n",
+               atomic_read(&path_rejects_atomic));
+    seq_printf(m, "fs_injector_rejects_total{filter=\"callsite\"} %d\n",
+               atomic_read(&callsite_rejects));
+    seq_printf(m, "fs_injector_rejects_total{filter=\"errno\"} %d\n",
+               atomic_read(&errno_rejects_atomic));
+    seq_puts(m, "# TYPE fs_injector_burst_injections_total counter\n");
+    seq_printf(m, "fs_injector_burst_injections_total %d\n",
+               atomic_read(&burst_injections_atomic));
+    seq_puts(m, "# TYPE fs_injector_burst_active gauge\n");
+    seq_printf(m, "fs_injector_burst_active %d\n",
+               fs_burst_active(ktime_get_ns()));
+
+    seq_puts(m, "# TYPE fs_injector_nmissed_total counter\n");
+    for (i = 0; i < fs_nprobes; i++)
+        seq_printf(m, "fs_injector_nmissed_total{symbol=\"%s\"} %lu\n",
+                   fs_probes[i].symbol,
+                   (unsigned long)fs_probes[i].rp.nmissed +
+                   fs_probes[i].rp.kp.nmissed);
+
+    seq_puts(m, "# TYPE fs_injector_calls_total counter\n");
+    for (i = 0; i < fs_nprobes; i++) {
+        seq_printf(m, "fs_injector_calls_total{symbol=\"%s\",errno=\"0\"} "
+                   "%llu\n", fs_probes[i].symbol,
+                   fs_errhist_sum(i, 0, false));
+        for (e = 1; e < ERRNO_SLOTS; e++) {
+            u64 n = fs_errhist_sum(i, e, false);
+
+            if (n)
+                seq_printf(m, "fs_injector_calls_total{symbol=\"%s\","
+                           "errno=\"%d\"} %llu\n",
+                           fs_probes[i].symbol, e, n);
+        }
+    }
+
+    seq_puts(m, "# TYPE fs_injector_injected_total counter\n");
+    for (i = 0; i < fs_nprobes; i++) {
+        for (e = 1; e < ERRNO_SLOTS; e++) {
+            u64 n = fs_errhist_sum(i, e, true);
+
+            if (n)
+                seq_printf(m, "fs_injector_injected_total{symbol=\"%s\","
+                           "errno=\"%d\"} %llu\n",
+                           fs_probes[i].symbol, e, n);
+        }
+    }
+    return 0;
+}
+
+DEFINE_SHOW_ATTRIBUTE(fs_metrics);
+
+/* Index of the probe for sym, adding one if needed; sym must stay alive */
+static int fs_add_probe(const char *sym)
+{
+    struct fs_probe *p;
+    int i;
+
+    for (i = 0; i < fs_nprobes; i++)
+        if (!strcmp(fs_probes[i].symbol, sym))
+            return i;
+
+    if (fs_nprobes >= MAX_PROBES) {
+        pr_err("fs_injector: more than %d symbols\n", MAX_PROBES);
+        return -E2BIG;
+    }
+    p = &fs_probes[fs_nprobes];
+    p->symbol = sym;
+    p->path_arg = -1;
+    p->dirfd_arg = -1;
+    p->fd_arg = -1;
+    p->rp.handler = fs_ret_handler;
+    p->rp.entry_handler = fs_entry_handler;
+    p->rp.data_size = sizeof(struct fs_call);
+    p->rp.maxactive = 20;
+    p->rp.kp.symbol_name = sym;
+    return fs_nprobes++;
+}
+
+/* Split target_symbol on ',' into fs_probes[] */
+static int fs_setup_probes(void)
 {
+    char *cur, *sym;
     int ret;
 
+    fs_symbols_buf = kstrdup(target_symbol, GFP_KERNEL);
+    if (!fs_symbols_buf)
+        return -ENOMEM;
+
+    cur = fs_symbols_buf;
+    while ((sym = strsep(&cur, ",")) != NULL) {
+        if (!*sym)
+            continue;
+        ret = fs_add_probe(sym);
+        if (ret < 0)
+            return ret;
+    }
+
+    return fs_nprobes ? 0 : -EINVAL;
+}
+
+static char *fs_chain_buf;      /* backing store for chain-only symbols */
+
+/* Parse chain_spec into fs_chain[], hooking any symbol not yet probed */
+static int fs_parse_chain(void)
+{
+    char *cur, *tok;
+
+    if (!chain_spec || !*chain_spec)
+        return 0;
+
+    fs_chain_buf = kstrdup(chain_spec, GFP_KERNEL);
+    if (!fs_chain_buf)
+        return -ENOMEM;
+
+    cur = fs_chain_buf;
+    while ((tok = strsep(&cur, ",")) != NULL) {
+        struct fs_chain_step *step;
+        char *colon, *star;
+        int probe;
+
+        if (!*tok)
+            continue;
+        if (fs_chain_n >= CHAIN_MAX)
+            return -E2BIG;
+        step = &fs_chain[fs_chain_n];
+
+        colon = strchr(tok, ':');
+        if (!colon)
+            goto bad;
+        *colon = '\0';
+        star = strchr(colon + 1, '*');
+        step->count = 1;
+        if (star) {
+            *star = '\0';
+            if (kstrtoint(star + 1, 10, &step->count) || step->count < 1)
+                goto bad;
+        }
+        if (kstrtoint(colon + 1, 10, &step->err) || step->err <= 0)
+            goto bad;
+
+        probe = fs_add_probe(tok);
+        if (probe < 0)
+            return probe;
+        step->probe = probe;
+        fs_chain_n++;
+    }
+    return 0;
+
+bad:
+    pr_err("fs_injector: bad chain_spec step '%s'\n", tok);
+    return -EINVAL;
+}
+
+static char *fs_burst_buf;      /* backing store for burst-only symbols */
+
+/* Parse burst_spec into fs_probes[].burst_errno, hooking new symbols */
+static int fs_parse_burst(void)
+{
+    char *cur, *tok;
+    int i;
+
+    if (!burst_spec || !*burst_spec) {
+        for (i = 0; i < fs_nprobes; i++)
+            fs_probes[i].burst_errno = EIO;
+        return 0;
+    }
+
+    fs_burst_buf = kstrdup(burst_spec, GFP_KERNEL);
+    if (!fs_burst_buf)
+        return -ENOMEM;
+
+    cur = fs_burst_buf;
+    while ((tok = strsep(&cur, ",")) != NULL) {
+        char *colon;
+        int e = EIO;
+
+        if (!*tok)
+            continue;
+        colon = strchr(tok, ':');
+        if (colon) {
+            *colon = '\0';
+            if (kstrtoint(colon + 1, 10, &e) || e <= 0 ||
+                e >= ERRNO_SLOTS) {
+                pr_err("fs_injector: bad burst_spec errno for %s\n", tok);
+                return -EINVAL;
+            }
+        }
+        i = fs_add_probe(tok);
+        if (i < 0)
+            return i;
+        fs_probes[i].burst_errno = e;
+    }
+    return 0;
+}
+
+/* Mark the probes listed in vmfault_symbols */
+static int fs_parse_vmfault(void)
+{
+    char *buf, *cur, *sym;
+    int i, ret = 0;
+
+    if (!vmfault_symbols || !*vmfault_symbols)
+        return 0;
+
+    buf = kstrdup(vmfault_symbols, GFP_KERNEL);
+    if (!buf)
+        return -ENOMEM;
+
+    cur = buf;
+    while ((sym = strsep(&cur, ",")) != NULL) {
+        if (!*sym)
+            continue;
+        i = fs_probe_index(sym);
+        if (i < 0) {
+            pr_err("fs_injector: vmfault symbol %s is not hooked\n", sym);
+            ret = -ENOENT;
+            break;
+        }
+        fs_probes[i].vmfault = true;
+    }
+
+    kfree(buf);
+    return ret;
+}
+
+static void fs_unregister_probes(int n)
+{
+    while (n-- > 0)
+        unregister_kretprobe(&fs_probes[n].rp);
+}
+
+static int __init fs_injector_init(void)
+{
+    int ret, i;
+
     if (!target_symbol || !*target_symbol) {
         pr_err("fs_injector: target_symbol must be non-empty\n");
         return -EINVAL;
@@ -120,33 +2315,125 @@ static int __init fs_injector_init(void)
         return -EINVAL;
     }
 
+    if (callsite_depth < 0 || callsite_depth > CALLSITE_FRAMES) {
+        pr_err("fs_injector: callsite_depth must be 0..%d, got %d\n",
+               CALLSITE_FRAMES, callsite_depth);
+        return -EINVAL;
+    }
+
+    if (fault_mode == FAULT_SHORT && vmfault_symbols && *vmfault_symbols) {
+        pr_err("fs_injector: short mode cannot hook vm_fault_t symbols\n");
+        return -EINVAL;
+    }
+
+    if (fault_mode == FAULT_SHORT &&
+        (count_arg < 0 || count_arg > 5 || short_pct < 0 || short_pct > 100)) {
+        pr_err("fs_injector: short mode needs count_arg in 0..5 and "
+               "short_pct in 0..100 (got %d, %d)\n", count_arg, short_pct);
+        return -EINVAL;
+    }
+
     atomic_set(&injections_done_atomic, 0);
     atomic_set(&inj_id, 0);
+    atomic_set(&eligible_calls, 0);
     injections_done = 0;
 
-    fs_kretprobe.kp.symbol_name = target_symbol;
-
-    ret = register_kretprobe(&fs_kretprobe);
-    if (ret < 0) {
-        pr_err("fs_injector: register_kretprobe(%s) failed: %d\n",
-               target_symbol, ret);
+    ret = fs_setup_probes();
+    if (!ret)
+        ret = fs_parse_chain();
+    if (!ret)
+        ret = fs_parse_burst();
+    if (!ret)
+        ret = fs_parse_vmfault();
+    if (!ret && fault_mode == FAULT_DELAY)
+        ret = fs_parse_delay_spec();
+    if (!ret)
+        ret = fs_load_prefixes();
+    if (!ret)
+        ret = fs_parse_path_spec();
+    if (!ret)
+        ret = fs_parse_errno_allow();
+    if (!ret) {
+        fs_errhist = __alloc_percpu(sizeof(struct fs_errhist) * fs_nprobes,
+                                    __alignof__(struct fs_errhist));
+        if (!fs_errhist)
+            ret = -ENOMEM;
+    }
+    if (ret) {
+        kfree(fs_chain_buf);
+        kfree(fs_burst_buf);
+        kfree(fs_symbols_buf);
         return ret;
     }
 
+    kernel_param_lock(THIS_MODULE);
+    fs_allow_ready = true;
+    fs_inject_errno_update();
+    kernel_param_unlock(THIS_MODULE);
+
+    if (fault_mode == FAULT_DELAY) {
+        fs_task_work_add = fs_lookup_symbol("task_work_add");
+        if (!fs_task_work_add)
+            pr_warn("fs_injector: task_work_add not found, "
+                    "delays over delay_spin_us are skipped\n");
+    }
+
+    fs_debugfs_dir = debugfs_create_dir("fs_injector", NULL);
+    debugfs_create_file("schedule", 0600, fs_debugfs_dir, NULL,
+                        &fs_schedule_fops);
+    debugfs_create_file("errors", 0600, fs_debugfs_dir, NULL,
+                        &fs_errors_fops);
+    debugfs_create_file("metrics", 0400, fs_debugfs_dir, NULL,
+                        &fs_metrics_fops);
+    if (callsite_depth > 0)
+        debugfs_create_file("callsites", 0400, fs_debugfs_dir, NULL,
+                            &fs_callsites_fops);
+
+    for (i = 0; i < fs_nprobes; i++) {
+        ret = register_kretprobe(&fs_probes[i].rp);
+        if (ret < 0) {
+            pr_err("fs_injector: register_kretprobe(%s) failed: %d\n",
+                   fs_probes[i].symbol, ret);
+            fs_unregister_probes(i);
+            debugfs_remove_recursive(fs_debugfs_dir);
+            free_percpu(fs_errhist);
+            kfree(fs_chain_buf);
+            kfree(fs_burst_buf);
+            kfree(fs_symbols_buf);
+            return ret;
+        }
+    }
+
     pr_info("fs_injector: loaded. target_symbol=%s target_pid=%d "
-            "inject_errno=%d unsafe_mode=%d max_injections=%d\n",
-            target_symbol, target_pid, inject_errno,
-            unsafe_mode, max_injections);
+            "target_comm=%s inject_errno=%d unsafe_mode=%d "
+            "max_injections=%d inject_every=%d fault_mode=%d "
+            "record=%d replay=%d chain_steps=%d probes=%d burst_spec=%s\n",
+            target_symbol, target_pid, target_comm, inject_errno,
+            unsafe_mode, max_injections, inject_every, fault_mode,
+            record, replay, fs_chain_n, fs_nprobes,
+            burst_spec && *burst_spec ? burst_spec : "all");
 
     return 0;
 }
 
 static void __exit fs_injector_exit(void)
 {
-    unregister_kretprobe(&fs_kretprobe);
+    fs_unregister_probes(fs_nprobes);
+    /* no handler can queue a sleeper now; let the queued ones finish */
+    wait_event(fs_sleepers_wq, !atomic_read(&fs_sleepers));
+    synchronize_rcu();
+    debugfs_remove_recursive(fs_debugfs_dir);
+    free_percpu(fs_errhist);
+    kfree(fs_chain_buf);
+    kfree(fs_burst_buf);
+    kfree(fs_symbols_buf);
+    /* handlers are gone once the probes are unregistered */
+    kfree(rcu_dereference_protected(fs_cgroups, 1));
+    kfree(rcu_dereference_protected(fs_callsites, 1));
+    kfree(rcu_dereference_protected(fs_burst, 1));
+    kvfree(rcu_dereference_protected(fs_replay, 1));
     pr_info("fs_injector: unloaded. injections_done=%d\n", injections_done);
 }
 
 module_init(fs_injector_init);
 module_exit(fs_injector_exit);
-
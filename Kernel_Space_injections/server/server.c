@@ -18,10 +18,27 @@
 #include <utime.h>
 #include <sys/mount.h>
 #include <time.h>
+#include <stdint.h>
+#include <signal.h>
+#include <sched.h>
+#include <ftw.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/ioctl.h>
+#include <linux/kcov.h>
+#include <setjmp.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/prctl.h>
+#include <linux/seccomp.h>
+#include <linux/filter.h>
+#include <linux/audit.h>
 
 
 /* ============================================================
-   MODES — MUST MATCH file_system.json "name" FIELDS
+   MODES — MUST MATCH json/catalogue.json "syscalls" KEYS
    ============================================================ */
 
 static const char *modes[] = {
@@ -87,24 +104,198 @@ static const char *modes[] = {
     "utime",
     "utimensat",
     "utimes",
-    "vmsplice"
+    "vmsplice",
+
+    /* data-path streaming modes */
+    "read",
+    "write",
+    "pread64",
+    "pwritev",
+    "preadv2",
+
+    /* memory-mapped modes */
+    "mmap",
+    "msync",
+    "madvise",
+    "mremap"
 };
 
 enum { MODE_COUNT = sizeof(modes) / sizeof(modes[0]) };
 
 
+/* ============================================================
+   OPTIONS
+   ============================================================ */
+
+#define STREAM_FILE   "tmp/stream.bin"
+#define STREAM_ALIGN  4096
+#define POOL_MAX      64
+
+enum { MAP_SEQ, MAP_REVERSE, MAP_RANDOM };
+
+static struct {
+    size_t block_size;   /* --block-size=  bytes per read/write call */
+    size_t file_size;    /* --file-size=   bytes streamed per iteration */
+    int    direct;       /* --direct       O_DIRECT via aligned buffer pool */
+    int    pool_bufs;    /* --pool=        buffers in the pool (iovec count) */
+    int    fsync_every;  /* --fsync-every= fsync after every N blocks, 0 = off */
+    size_t copy_size;    /* --copy-size=   bytes per copy scenario, 0 = legacy */
+    int    lat_report;   /* --lat-report=  seconds between latency lines, 0 = exit only */
+    const char *lat_log; /* --lat-log=     per-iteration latency CSV */
+    const char *metrics_shm; /* --metrics-shm= live counters for metrics.py */
+    const char *kcov_log; /* --kcov-log=   per-iteration kernel edge coverage */
+    int    kcov_baseline; /* --kcov-baseline= seconds of workload-only edges, 0 = off */
+    long   dir_entries;  /* --dir-entries= files in big/, 0 = not built */
+    int    path_depth;   /* --path-depth=  levels in the deep/ chain, 0 = off */
+    int    build_jobs;   /* --build-jobs=  parallel sandbox builders, 0 = CPUs */
+    size_t dirent_buf;   /* --dirent-buf=  getdents buffer size */
+    const char *target_dir; /* --target-dir= directory getdents scans */
+    size_t map_size;     /* --map-size=    bytes mapped per iteration */
+    int    map_pattern;  /* --map-pattern= page visiting order (MAP_*) */
+    int    map_write;    /* --map-write    dirty pages instead of reading */
+    int    map_cold;     /* --map-cold     drop the file's cache first */
+    const char *sandbox; /* --sandbox=     sandbox directory (e.g. on a loop mount) */
+    int    ttr_k;        /* --ttr-k=       consecutive successes that end an episode */
+    int    ttr_window;   /* --ttr-window=  seconds of pre-fault baseline */
+    const char *burst_window; /* --burst-window= injector burst_window file */
+    const char *seccomp; /* --seccomp=     rules for the seccomp backend */
+} opt = {
+    .block_size  = 64 * 1024,
+    .file_size   = 4 * 1024 * 1024,
+    .direct      = 0,
+    .pool_bufs   = 4,
+    .fsync_every = 0,
+    .copy_size   = 0,
+    .lat_report  = 5,
+    .lat_log     = NULL,
+    .metrics_shm = NULL,
+    .kcov_log    = NULL,
+    .kcov_baseline = 0,
+    .dir_entries = 0,
+    .path_depth  = 0,
+    .build_jobs  = 0,
+    .dirent_buf  = 4096,
+    .target_dir  = NULL,
+    .map_size    = 4 * 1024 * 1024,
+    .map_pattern = 0,
+    .map_write   = 0,
+    .map_cold    = 0,
+    .sandbox     = "fs_sandbox",
+    .ttr_k       = 3,
+    .ttr_window  = 5,
+    .burst_window = NULL,
+    .seccomp     = NULL,
+};
+
+/* tee moves data between pipes, so its transfer is bounded by pipe capacity */
+#define TEE_MAX  65536
+
+
 /* ============================================================
    UTILITIES
    ============================================================ */
 
 static void usage(void)
 {
-    printf("Usage: ./server --mode=<name>\n");
+    printf("Usage: ./server --mode=<name> [options]\n");
+    printf("Data-path options (read/write/pread64/pwritev/preadv2):\n");
+    printf("  --block-size=N[K|M]   bytes per call (default 64K)\n");
+    printf("  --file-size=N[K|M|G]  bytes per iteration (default 4M)\n");
+    printf("  --direct              O_DIRECT with an aligned buffer pool\n");
+    printf("  --pool=N              pool buffers / iovec count (default 4)\n");
+    printf("  --fsync-every=N       fsync after every N written blocks\n");
+    printf("Mapping options (mmap/msync/madvise/mremap):\n");
+    printf("  --map-size=N[K|M|G]   bytes mapped per iteration (default 4M)\n");
+    printf("  --map-pattern=P       page order: seq, reverse or random\n");
+    printf("  --map-write           dirty each page (msync always does)\n");
+    printf("  --map-cold            drop the file's page cache before mapping\n");
+    printf("Copy options (sendfile/splice/copy_file_range/tee):\n");
+    printf("  --copy-size=N[K|M]    bytes per copy, retried until complete\n");
+    printf("Injection without fs_injector (all modes):\n");
+    printf("  --seccomp=RULES       fail syscalls from a seccomp filter, rules\n");
+    printf("                        name:errno[*max][@every][%%pct],...\n");
+    printf("Sandbox options (all modes):\n");
+    printf("  --sandbox=DIR         sandbox directory (default fs_sandbox)\n");
+    printf("Latency options (all modes):\n");
+    printf("  --lat-report=SECS     windowed percentile report period (0 = exit only)\n");
+    printf("  --lat-log=FILE        append start_ns,latency_ns,fails per iteration\n");
+    printf("  --metrics-shm=FILE    live counters in a shared mapping (metrics.py)\n");
+    printf("  --ttr-k=N             successes in a row that end a fault (default 3)\n");
+    printf("  --ttr-window=SECS     pre-fault baseline for lost throughput (default 5)\n");
+    printf("  --burst-window=FILE   report throughput around the injector's burst\n");
+    printf("                        windows (its burst_window parameter)\n");
+    printf("  --kcov-log=FILE       trace kernel coverage per iteration (needs kcov),\n");
+    printf("                        append start_ns,total_edges,new_edges\n");
+    printf("  --kcov-baseline=SECS  edges of the first SECS seconds are the workload's\n");
+    printf("                        own; later lines add the distinct edge hashes\n");
+    printf("                        outside that set\n");
+    printf("Sandbox scaling options:\n");
+    printf("  --dir-entries=N       build big/ with N files (kept between runs)\n");
+    printf("  --path-depth=N        path scenarios resolve through N nested dirs\n");
+    printf("  --build-jobs=N        parallel sandbox builders (default CPUs)\n");
+    printf("  --dirent-buf=N[K|M]   getdents buffer size (default 4K)\n");
+    printf("  --target-dir=DIR      directory getdents reads (default big/ or .)\n");
+    printf("  --scale-entries=N,..  sweep directory sizes, one SCALE line each\n");
+    printf("  --scale-depth=N,..    sweep path depths, one SCALE line each\n");
+    printf("  --scale-iters=N       iterations per sweep level (default 100)\n");
+    printf("Errno discovery (no --mode needed):\n");
+    printf("  --discover[=MODE]     run scenarios in perturbed sandboxes, list errnos\n");
+    printf("  --discover-out=FILE   write \"mode perturbation errnos\" lines to FILE\n");
     printf("Available modes:\n");
     for (int i = 0; i < MODE_COUNT; i++)
         printf("  %s\n", modes[i]);
 }
 
+/* Parse "64K", "4M", "1G" style sizes. Returns 0 on malformed input. */
+static size_t parse_size(const char *s)
+{
+    char *end;
+    unsigned long long v = strtoull(s, &end, 10);
+    switch (*end) {
+    case 'k': case 'K': v <<= 10; end++; break;
+    case 'm': case 'M': v <<= 20; end++; break;
+    case 'g': case 'G': v <<= 30; end++; break;
+    default: break;
+    }
+    if (end == s || *end != '\0')
+        return 0;
+    return (size_t)v;
+}
+
+static double now_sec(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* Bytes a copy scenario moves per iteration: --copy-size or its legacy size */
+static size_t copy_len(size_t legacy)
+{
+    return opt.copy_size ? opt.copy_size : legacy;
+}
+
+/*
+ * Copy scenarios retry short transfers until the full length is moved.
+ * `retries` counts the extra calls caused by short counts.
+ */
+static void xfer_report(const char *sc, size_t bytes, int calls, int retries,
+                        double t0)
+{
+    double secs = now_sec() - t0;
+    printf("[SERVER] %s TRANSFER bytes=%zu calls=%d retries=%d "
+           "secs=%.6f Bps=%.0f\n",
+           sc, bytes, calls, retries, secs, secs > 0 ? bytes / secs : 0.0);
+    fflush(stdout);
+}
+
 static int mode_index(const char *arg)
 {
     for (int i = 0; i < MODE_COUNT; i++) {
@@ -114,19 +305,110 @@ static int mode_index(const char *arg)
     return -1;
 }
 
+/*
+ * Errno discovery (--discover): every scenario runs once in a perturbed
+ * sandbox and log_fail() records the errno instead of printing it.
+ */
+#define DISC_ERRNOS  256
+
+struct disc_result {
+    int ran;                    /* scenario completed */
+    int unexercised;            /* stub, or setup failed before the call */
+    uint64_t errs[DISC_ERRNOS / 64];
+};
+
+static struct disc_result *disc_cur;
+static const char *disc_mode;   /* only its own failures are recorded */
+
+/* FAIL lines printed so far; per-iteration deltas give the cascade length */
+static unsigned long fail_count;
+
+/* First FAIL of the current iteration, which names a recovery episode */
+static const char *iter_fail_sc;
+static int iter_fail_errno;
+
+/*
+ * --metrics-shm=PATH: live counters in a shared file mapping, exported by
+ * controller/metrics.py. The server is the only writer. Fields are bumped
+ * with relaxed atomics, so a reader never sees a torn value and the
+ * workload never waits on one.
+ */
+#define METRICS_MAGIC    "FSMETRIC"
+#define METRICS_VERSION  1
+#define METRICS_ERRNOS   134
+#define METRICS_BUCKETS  8      /* latency <= 1us, 10us, ... 1s, +Inf */
+
+struct metrics_shm {
+    char     magic[8];
+    uint32_t version;
+    uint32_t pid;
+    char     mode[32];
+    uint64_t iterations;
+    uint64_t fail_iters;
+    uint64_t fails;
+    uint64_t sigbus;
+    uint64_t lat_sum_ns;
+    uint64_t lat_bucket[METRICS_BUCKETS];   /* not cumulative */
+    uint64_t fail_errno[METRICS_ERRNOS];
+};
+
+static struct metrics_shm *metrics;
+
+#define METRIC_ADD(field, n) \
+    __atomic_fetch_add(&metrics->field, (n), __ATOMIC_RELAXED)
+
 static void log_fail(const char *sc, const char *detail, int ret)
 {
+    if (disc_cur) {
+        /* errno is cleared before each scenario; 0 means no syscall ran.
+         * A failure of any other syscall (setup, cleanup) is not an errno
+         * of the mode under discovery. */
+        if (errno == 0 || strcmp(sc, disc_mode) != 0)
+            disc_cur->unexercised = 1;
+        else if (errno < DISC_ERRNOS)
+            disc_cur->errs[errno / 64] |= 1ull << (errno % 64);
+        return;
+    }
+    fail_count++;
+    if (metrics) {
+        METRIC_ADD(fails, 1);
+        if (errno > 0 && errno < METRICS_ERRNOS)
+            METRIC_ADD(fail_errno[errno], 1);
+    }
+    if (!iter_fail_sc) {
+        iter_fail_sc = sc;
+        iter_fail_errno = errno;
+    }
     printf("[SERVER] %s FAIL ret=%d errno=%d (%s) detail=%s\n",
            sc, ret, errno, strerror(errno),
            detail ? detail : "");
     fflush(stdout);
 }
 
+/* A scenario's setup failed silently: its syscall never ran */
+static void setup_failed(void)
+{
+    if (disc_cur)
+        disc_cur->unexercised = 1;
+}
+
+static void fill_file(const char *path, char ch, size_t size)
+{
+    int fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0600);
+    if (fd < 0)
+        return;
+    char buf[4096];
+    memset(buf, ch, sizeof(buf));
+    for (size_t off = 0; off < size; off += sizeof(buf))
+        write(fd, buf, size - off < sizeof(buf) ? size - off : sizeof(buf));
+    close(fd);
+}
+
 static void sandbox_init(void)
 {
-    mkdir("fs_sandbox", 0700);
-    if (chdir("fs_sandbox") < 0) {
-        perror("chdir fs_sandbox");
+    mkdir(opt.sandbox, 0700);
+    if (chdir(opt.sandbox) < 0) {
+        perror("chdir sandbox");
         exit(1);
     }
 
@@ -197,6 +479,215 @@ static void sandbox_init(void)
         write(fd8, buf2, sizeof(buf2));
         close(fd8);
     }
+
+    /* Larger copy sources when --copy-size asks for more than the defaults */
+    if (opt.copy_size > 1024)
+        fill_file("tmp_copy_src.bin", 'A', opt.copy_size);
+    if (opt.copy_size > 2048)
+        fill_file("tmp/sendfile_src", 'B', opt.copy_size);
+}
+
+/* ============================================================
+   SANDBOX SCALING
+   ============================================================ */
+
+/*
+ * big/ holds --dir-entries empty files named f0000000, f0000001, ...;
+ * big.entries records how many, so a rerun (or the next sweep level)
+ * only creates or removes the difference. deep/d/d/.../file_ok.txt is
+ * the --path-depth chain the path scenarios resolve through.
+ */
+#define BIG_DIR      "big"
+#define BIG_MARKER   "big.entries"
+#define DEEP_DIR     "deep"
+#define DEPTH_MAX    ((PATH_MAX - 32) / 2)
+
+static char deep_path[PATH_MAX];
+static char *dirent_buf;
+
+/* File the path scenarios use: the deep chain's leaf when --path-depth is set */
+static const char *target_file(void)
+{
+    return opt.path_depth > 0 ? deep_path : "file_ok.txt";
+}
+
+static const char *scan_dir(void)
+{
+    if (opt.target_dir)
+        return opt.target_dir;
+    return opt.dir_entries > 0 ? BIG_DIR : ".";
+}
+
+/* Highest f%07ld index + 1 in big/; only needed when the marker is missing */
+static long big_scan(void)
+{
+    DIR *d = opendir(BIG_DIR);
+    if (!d)
+        return 0;
+    long hi = 0;
+    struct dirent *de;
+    while ((de = readdir(d)) != NULL) {
+        if (de->d_name[0] != 'f')
+            continue;
+        long n = strtol(de->d_name + 1, NULL, 10) + 1;
+        if (n > hi)
+            hi = n;
+    }
+    closedir(d);
+    return hi;
+}
+
+/* Create (or remove) big/f[lo, hi) across --build-jobs forked workers */
+static int big_range(long lo, long hi, int create)
+{
+    int jobs = opt.build_jobs > 0 ? opt.build_jobs
+                                  : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (jobs < 1)
+        jobs = 1;
+    if (hi - lo < jobs)
+        jobs = 1;
+
+    for (int j = 0; j < jobs; j++) {
+        pid_t pid = fork();
+        if (pid < 0)
+            return -1;
+        if (pid > 0)
+            continue;
+        int dfd = open(BIG_DIR, O_RDONLY | O_DIRECTORY);
+        if (dfd < 0)
+            _exit(1);
+        char name[32];
+        int rc = 0;
+        for (long i = lo + j; i < hi; i += jobs) {
+            snprintf(name, sizeof(name), "f%07ld", i);
+            int ret = create ? mknodat(dfd, name, S_IFREG | 0600, 0)
+                             : unlinkat(dfd, name, 0);
+            if (ret < 0 && errno != (create ? EEXIST : ENOENT))
+                rc = 1;
+        }
+        _exit(rc);
+    }
+
+    int status, failed = 0;
+    while (wait(&status) > 0)
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            failed = 1;
+    return failed ? -1 : 0;
+}
+
+static int big_build(long entries)
+{
+    long have = -1;
+    FILE *m = fopen(BIG_MARKER, "r");
+    if (m) {
+        if (fscanf(m, "%ld", &have) != 1)
+            have = -1;
+        fclose(m);
+    }
+    if (have == entries)
+        return 0;
+
+    mkdir(BIG_DIR, 0700);
+    unlink(BIG_MARKER);
+
+    /*
+     * No marker: first build or an interrupted one. The names give the
+     * upper bound, but not the holes below it, so create from 0.
+     */
+    long lo = have;
+    if (have < 0) {
+        have = big_scan();
+        lo = 0;
+    }
+    if (entries > lo && big_range(lo, entries, 1) < 0)
+        return -1;
+    if (entries < have && big_range(entries, have, 0) < 0)
+        return -1;
+
+    m = fopen(BIG_MARKER, "w");
+    if (!m)
+        return -1;
+    fprintf(m, "%ld\n", entries);
+    fclose(m);
+    return 0;
+}
+
+/* mkdirat walk, so the chain is built without ever resolving a long path */
+static int deep_build(int depth)
+{
+    int dfd = open(".", O_RDONLY | O_DIRECTORY);
+    const char *name = DEEP_DIR;
+    for (int i = 0; i <= depth && dfd >= 0; i++) {
+        mkdirat(dfd, name, 0700);
+        int next = openat(dfd, name, O_RDONLY | O_DIRECTORY);
+        close(dfd);
+        dfd = next;
+        name = "d";
+    }
+    if (dfd < 0)
+        return -1;
+    int fd = openat(dfd, "file_ok.txt", O_CREAT | O_WRONLY | O_TRUNC, 0600);
+    close(dfd);
+    if (fd < 0)
+        return -1;
+    write(fd, "hello\n", 6);
+    close(fd);
+
+    int len = snprintf(deep_path, sizeof(deep_path), DEEP_DIR);
+    for (int i = 0; i < depth; i++)
+        len += snprintf(deep_path + len, sizeof(deep_path) - len, "/d");
+    snprintf(deep_path + len, sizeof(deep_path) - len, "/file_ok.txt");
+    return 0;
+}
+
+/* Bring big/ and deep/ to the current --dir-entries / --path-depth */
+static int sandbox_scale(void)
+{
+    if (opt.dir_entries <= 0 && opt.path_depth <= 0)
+        return 0;
+    double t0 = now_sec();
+    if (opt.dir_entries > 0 && big_build(opt.dir_entries) < 0) {
+        fprintf(stderr, "building %s with %ld entries failed\n",
+                BIG_DIR, opt.dir_entries);
+        return -1;
+    }
+    if (opt.path_depth > 0 && deep_build(opt.path_depth) < 0) {
+        fprintf(stderr, "building %s at depth %d failed\n",
+                DEEP_DIR, opt.path_depth);
+        return -1;
+    }
+    printf("[SERVER] SANDBOX entries=%ld depth=%d build_secs=%.3f\n",
+           opt.dir_entries, opt.path_depth, now_sec() - t0);
+    fflush(stdout);
+    return 0;
+}
+
+/* getdents calls made by the last scan; part of the SCALE report */
+static unsigned long scan_calls;
+
+/*
+ * Read the whole --target-dir with --dirent-buf sized calls. The scan
+ * stops at the first failure, wherever in the directory it lands.
+ */
+static void dir_scan(const char *sc, long nr)
+{
+    if (!dirent_buf && !(dirent_buf = malloc(opt.dirent_buf))) {
+        setup_failed();
+        return;
+    }
+    int fd = open(scan_dir(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) { setup_failed(); return; }
+    for (;;) {
+        long ret = syscall(nr, fd, dirent_buf, opt.dirent_buf);
+        scan_calls++;
+        if (ret < 0) {
+            log_fail(sc, scan_dir(), (int)ret);
+            break;
+        }
+        if (ret == 0)
+            break;
+    }
+    close(fd);
 }
 
 /* ============================================================
@@ -206,8 +697,8 @@ static void sandbox_init(void)
 /* 0: access */
 static void sc_access(void)
 {
-    int ret = access("file_ok.txt", R_OK);
-    if (ret < 0) log_fail("access", "file_ok.txt", ret);
+    int ret = access(target_file(), R_OK);
+    if (ret < 0) log_fail("access", target_file(), ret);
 }
 
 /* 1: chdir */
@@ -228,22 +719,22 @@ static void sc_chdir(void)
 /* 2: chmod */
 static void sc_chmod(void)
 {
-    int ret = chmod("file_ok.txt", 0600);
-    if (ret < 0) log_fail("chmod", "file_ok.txt", ret);
+    int ret = chmod(target_file(), 0600);
+    if (ret < 0) log_fail("chmod", target_file(), ret);
 }
 
 /* 3: chown */
 static void sc_chown(void)
 {
-    int ret = chown("file_ok.txt", getuid(), getgid());
-    if (ret < 0) log_fail("chown", "file_ok.txt", ret);
+    int ret = chown(target_file(), getuid(), getgid());
+    if (ret < 0) log_fail("chown", target_file(), ret);
 }
 
 /* 4: close */
 static void sc_close(void)
 {
     int fd = open("file_ok.txt", O_RDONLY);
-    if (fd < 0) return;
+    if (fd < 0) { setup_failed(); return; }
     int ret = close(fd);
     if (ret < 0) log_fail("close", "file_ok.txt", ret);
 }
@@ -260,8 +751,24 @@ static void sc_copy_file_range(void)
         return;
     }
     loff_t off = 0;
-    ssize_t ret = syscall(SYS_copy_file_range, src, &off, dst, NULL, 1024, 0);
-    if (ret < 0) log_fail("copy_file_range", "tmp_copy_src.bin", (int)ret);
+    size_t want = copy_len(1024), done = 0;
+    int calls = 0, retries = 0;
+    double t0 = now_sec();
+    while (done < want) {
+        ssize_t ret = syscall(SYS_copy_file_range, src, &off, dst, NULL,
+                              want - done, 0);
+        calls++;
+        if (ret < 0) {
+            log_fail("copy_file_range", "tmp_copy_src.bin", (int)ret);
+            break;
+        }
+        if (ret == 0)
+            break;          /* source exhausted */
+        done += ret;
+        if (done < want)
+            retries++;
+    }
+    xfer_report("copy_file_range", done, calls, retries, t0);
     close(src);
     close(dst);
 #else
@@ -273,8 +780,8 @@ static void sc_copy_file_range(void)
 static void sc_faccessat2(void)
 {
 #ifdef SYS_faccessat2
-    int ret = syscall(SYS_faccessat2, AT_FDCWD, "file_ok.txt", R_OK, 0);
-    if (ret < 0) log_fail("faccessat2", "file_ok.txt", ret);
+    int ret = syscall(SYS_faccessat2, AT_FDCWD, target_file(), R_OK, 0);
+    if (ret < 0) log_fail("faccessat2", target_file(), ret);
 #else
     log_fail("faccessat2", "unavailable", -1);
 #endif
@@ -285,7 +792,7 @@ static void sc_fallocate(void)
 {
 #ifdef SYS_fallocate
     int fd = open("tmp/falloc.bin", O_CREAT | O_RDWR, 0600);
-    if (fd < 0) return;
+    if (fd < 0) { setup_failed(); return; }
     int ret = syscall(SYS_fallocate, fd, 0, 0, 4096);
     if (ret < 0) log_fail("fallocate", "tmp/falloc.bin", ret);
     close(fd);
@@ -301,7 +808,7 @@ static void sc_fchdir(void)
     if (!getcwd(cwd, sizeof(cwd)))
         return;
     int fd = open("dir1", O_RDONLY | O_DIRECTORY);
-    if (fd < 0) return;
+    if (fd < 0) { setup_failed(); return; }
     int ret = fchdir(fd);
     if (ret < 0) log_fail("fchdir", "dir1", ret);
     close(fd);
@@ -312,7 +819,7 @@ static void sc_fchdir(void)
 static void sc_fchmod(void)
 {
     int fd = open("file_ok.txt", O_RDONLY);
-    if (fd < 0) return;
+    if (fd < 0) { setup_failed(); return; }
     int ret = fchmod(fd, 0644);
     if (ret < 0) log_fail("fchmod", "file_ok.txt", ret);
     close(fd);
@@ -322,7 +829,7 @@ static void sc_fchmod(void)
 static void sc_fchmodat(void)
 {
     int dfd = open(".", O_RDONLY);
-    if (dfd < 0) return;
+    if (dfd < 0) { setup_failed(); return; }
     int ret = fchmodat(dfd, "file_ok.txt", 0644, 0);
     if (ret < 0) log_fail("fchmodat", "file_ok.txt", ret);
     close(dfd);
@@ -332,7 +839,7 @@ static void sc_fchmodat(void)
 static void sc_fchown(void)
 {
     int fd = open("file_ok.txt", O_RDONLY);
-    if (fd < 0) return;
+    if (fd < 0) { setup_failed(); return; }
     int ret = fchown(fd, getuid(), getgid());
     if (ret < 0) log_fail("fchown", "file_ok.txt", ret);
     close(fd);
@@ -342,7 +849,7 @@ static void sc_fchown(void)
 static void sc_fchownat(void)
 {
     int dfd = open(".", O_RDONLY);
-    if (dfd < 0) return;
+    if (dfd < 0) { setup_failed(); return; }
     int ret = fchownat(dfd, "file_ok.txt", getuid(), getgid(), 0);
     if (ret < 0) log_fail("fchownat", "file_ok.txt", ret);
     close(dfd);
@@ -352,7 +859,7 @@ static void sc_fchownat(void)
 static void sc_fdatasync(void)
 {
     int fd = open("tmp_fdatasync.log", O_CREAT | O_WRONLY | O_APPEND, 0600);
-    if (fd < 0) return;
+    if (fd < 0) { setup_failed(); return; }
     write(fd, "fdatasync\n", 10);
     int ret = fdatasync(fd);
     if (ret < 0) log_fail("fdatasync", "tmp_fdatasync.log", ret);
@@ -370,7 +877,7 @@ static void sc_fsetxattr(void)
 {
 #ifdef SYS_fsetxattr
     int fd = open("file_ok.txt", O_RDONLY);
-    if (fd < 0) return;
+    if (fd < 0) { setup_failed(); return; }
     const char *name = "user.test";
     const char *value = "abc";
     int ret = syscall(SYS_fsetxattr, fd, name, value, strlen(value), 0);
@@ -403,7 +910,7 @@ static void sc_fspick(void)
 static void sc_fstat(void)
 {
     int fd = open("file_ok.txt", O_RDONLY);
-    if (fd < 0) return;
+    if (fd < 0) { setup_failed(); return; }
     struct stat st;
     int ret = fstat(fd, &st);
     if (ret < 0) log_fail("fstat", "file_ok.txt", ret);
@@ -414,7 +921,7 @@ static void sc_fstat(void)
 static void sc_fstatfs(void)
 {
     int fd = open(".", O_RDONLY);
-    if (fd < 0) return;
+    if (fd < 0) { setup_failed(); return; }
     struct statfs s;
     int ret = fstatfs(fd, &s);
     if (ret < 0) log_fail("fstatfs", ".", ret);
@@ -425,7 +932,7 @@ static void sc_fstatfs(void)
 static void sc_fsync(void)
 {
     int fd = open("tmp_fsync.log", O_CREAT | O_WRONLY | O_APPEND, 0600);
-    if (fd < 0) return;
+    if (fd < 0) { setup_failed(); return; }
     write(fd, "fsync\n", 6);
     int ret = fsync(fd);
     if (ret < 0) log_fail("fsync", "tmp_fsync.log", ret);
@@ -436,7 +943,7 @@ static void sc_fsync(void)
 static void sc_ftruncate(void)
 {
     int fd = open("tmp_trunc.log", O_RDWR);
-    if (fd < 0) return;
+    if (fd < 0) { setup_failed(); return; }
     int ret = ftruncate(fd, 0);
     if (ret < 0) log_fail("ftruncate", "tmp_trunc.log", ret);
     close(fd);
@@ -446,12 +953,7 @@ static void sc_ftruncate(void)
 static void sc_getdents(void)
 {
 #ifdef SYS_getdents
-    int fd = open(".", O_RDONLY | O_DIRECTORY);
-    if (fd < 0) return;
-    char buf[4096];
-    int ret = syscall(SYS_getdents, fd, buf, sizeof(buf));
-    if (ret < 0) log_fail("getdents", ".", ret);
-    close(fd);
+    dir_scan("getdents", SYS_getdents);
 #else
     log_fail("getdents", "unavailable", -1);
 #endif
@@ -461,12 +963,7 @@ static void sc_getdents(void)
 static void sc_getdents64(void)
 {
 #ifdef SYS_getdents64
-    int fd = open(".", O_RDONLY | O_DIRECTORY);
-    if (fd < 0) return;
-    char buf[4096];
-    int ret = syscall(SYS_getdents64, fd, buf, sizeof(buf));
-    if (ret < 0) log_fail("getdents64", ".", ret);
-    close(fd);
+    dir_scan("getdents64", SYS_getdents64);
 #else
     log_fail("getdents64", "unavailable", -1);
 #endif
@@ -528,10 +1025,11 @@ static void sc_mkdir(void)
 static void sc_mkdirat(void)
 {
     int dfd = open("tmp", O_RDONLY);
-    if (dfd < 0) return;
-    mkdirat(dfd, "mkdirat_test", 0700);
-    int ret = unlinkat(dfd, "mkdirat_test", AT_REMOVEDIR);
+    if (dfd < 0) { setup_failed(); return; }
+    int ret = mkdirat(dfd, "mkdirat_test", 0700);
     if (ret < 0) log_fail("mkdirat", "tmp/mkdirat_test", ret);
+    else if (unlinkat(dfd, "mkdirat_test", AT_REMOVEDIR) < 0)
+        log_fail("unlinkat", "tmp/mkdirat_test", -1);
     close(dfd);
 }
 
@@ -551,7 +1049,7 @@ static void sc_mknod(void)
 static void sc_mknodat(void)
 {
     int dfd = open("tmp", O_RDONLY);
-    if (dfd < 0) return;
+    if (dfd < 0) { setup_failed(); return; }
     unlinkat(dfd, "node2", 0);
     int ret = mknodat(dfd, "node2", S_IFREG | 0600, 0);
     if (ret < 0) {
@@ -578,8 +1076,8 @@ static void sc_mount_setattr(void)
 /* 35: open */
 static void sc_open(void)
 {
-    int fd = open("file_ok.txt", O_RDONLY);
-    if (fd < 0) log_fail("open", "file_ok.txt", fd);
+    int fd = open(target_file(), O_RDONLY);
+    if (fd < 0) log_fail("open", target_file(), fd);
     else close(fd);
 }
 
@@ -605,7 +1103,7 @@ static void sc_open_tree(void)
 static void sc_openat(void)
 {
     int dfd = open("dir1", O_RDONLY);
-    if (dfd < 0) return;
+    if (dfd < 0) { setup_failed(); return; }
     int fd = openat(dfd, "deep", O_RDONLY | O_DIRECTORY);
     if (fd < 0) log_fail("openat", "dir1/deep", fd);
     if (fd >= 0) close(fd);
@@ -617,8 +1115,8 @@ static void sc_openat2(void)
 {
 #ifdef SYS_openat2
     struct open_how how = { .flags = O_RDONLY };
-    int fd = syscall(SYS_openat2, AT_FDCWD, "file_ok.txt", &how, sizeof(how));
-    if (fd < 0) log_fail("openat2", "file_ok.txt", fd);
+    int fd = syscall(SYS_openat2, AT_FDCWD, target_file(), &how, sizeof(how));
+    if (fd < 0) log_fail("openat2", target_file(), fd);
     else close(fd);
 #else
     log_fail("openat2", "unavailable", -1);
@@ -630,7 +1128,7 @@ static void sc_readahead(void)
 {
 #ifdef SYS_readahead
     int fd = open("file_ok.txt", O_RDONLY);
-    if (fd < 0) return;
+    if (fd < 0) { setup_failed(); return; }
     int ret = syscall(SYS_readahead, fd, 0, 4096);
     if (ret < 0) log_fail("readahead", "file_ok.txt", ret);
     close(fd);
@@ -651,7 +1149,7 @@ static void sc_readlink(void)
 static void sc_readlinkat(void)
 {
     int dfd = open(".", O_RDONLY);
-    if (dfd < 0) return;
+    if (dfd < 0) { setup_failed(); return; }
     char b[128];
     int ret = readlinkat(dfd, "link1", b, sizeof(b)-1);
     if (ret < 0) log_fail("readlinkat", "link1", ret);
@@ -670,7 +1168,7 @@ static void sc_rename(void)
 static void sc_renameat(void)
 {
     int dfd = open("tmp", O_RDONLY);
-    if (dfd < 0) return;
+    if (dfd < 0) { setup_failed(); return; }
     renameat(dfd, "unlink_me", dfd, "unlink_tmp2");
     int ret = renameat(dfd, "unlink_tmp2", dfd, "unlink_me");
     if (ret < 0) log_fail("renameat", "tmp", ret);
@@ -682,7 +1180,7 @@ static void sc_renameat2(void)
 {
 #ifdef SYS_renameat2
     int dfd = open("tmp", O_RDONLY);
-    if (dfd < 0) return;
+    if (dfd < 0) { setup_failed(); return; }
     int ret = syscall(SYS_renameat2, dfd, "unlink_me", dfd, "unlink_tmp3", 0);
     if (ret < 0) log_fail("renameat2", "tmp/unlink_me", ret);
     close(dfd);
@@ -710,8 +1208,23 @@ static void sc_sendfile(void)
         return;
     }
     off_t offset = 0;
-    ssize_t ret = sendfile(dst, src, &offset, 1024);
-    if (ret < 0) log_fail("sendfile", "tmp/sendfile_src", (int)ret);
+    size_t want = copy_len(1024), done = 0;
+    int calls = 0, retries = 0;
+    double t0 = now_sec();
+    while (done < want) {
+        ssize_t ret = sendfile(dst, src, &offset, want - done);
+        calls++;
+        if (ret < 0) {
+            log_fail("sendfile", "tmp/sendfile_src", (int)ret);
+            break;
+        }
+        if (ret == 0)
+            break;          /* source exhausted */
+        done += ret;
+        if (done < want)
+            retries++;
+    }
+    xfer_report("sendfile", done, calls, retries, t0);
     close(src);
     close(dst);
 }
@@ -725,14 +1238,34 @@ static void sc_splice(void)
         log_fail("splice", "pipe", -1);
         return;
     }
-    int fd = open("file_ok.txt", O_RDONLY);
+    /* tmp_copy_src.bin, not file_ok.txt: the source must cover the length */
+    int fd = open("tmp_copy_src.bin", O_RDONLY);
     if (fd < 0) {
         close(pipefd[0]);
         close(pipefd[1]);
         return;
     }
-    ssize_t ret = syscall(SYS_splice, fd, NULL, pipefd[1], NULL, 64, 0);
-    if (ret < 0) log_fail("splice", "file_ok.txt", (int)ret);
+    static char drain[TEE_MAX];
+    size_t want = copy_len(64), done = 0;
+    int calls = 0, retries = 0;
+    double t0 = now_sec();
+    while (done < want) {
+        size_t n = want - done < TEE_MAX ? want - done : TEE_MAX;
+        ssize_t ret = syscall(SYS_splice, fd, NULL, pipefd[1], NULL, n, 0);
+        calls++;
+        if (ret < 0) {
+            log_fail("splice", "tmp_copy_src.bin", (int)ret);
+            break;
+        }
+        if (ret == 0)
+            break;          /* source exhausted */
+        read(pipefd[0], drain, ret);
+        done += ret;
+        /* a full pipe-sized chunk is not a short count */
+        if (done < want && (size_t)ret < n)
+            retries++;
+    }
+    xfer_report("splice", done, calls, retries, t0);
     close(fd);
     close(pipefd[0]);
     close(pipefd[1]);
@@ -745,8 +1278,8 @@ static void sc_splice(void)
 static void sc_stat(void)
 {
     struct stat st;
-    int ret = stat("file_ok.txt", &st);
-    if (ret < 0) log_fail("stat", "file_ok.txt", ret);
+    int ret = stat(target_file(), &st);
+    if (ret < 0) log_fail("stat", target_file(), ret);
 }
 
 /* 50: statfs */
@@ -762,10 +1295,10 @@ static void sc_statx(void)
 {
 #ifdef SYS_statx
     struct statx sx;
-    int ret = syscall(SYS_statx, AT_FDCWD, "file_ok.txt",
+    int ret = syscall(SYS_statx, AT_FDCWD, target_file(),
                       AT_STATX_SYNC_AS_STAT,
                       STATX_BASIC_STATS, &sx);
-    if (ret < 0) log_fail("statx", "file_ok.txt", ret);
+    if (ret < 0) log_fail("statx", target_file(), ret);
 #else
     log_fail("statx", "unavailable", -1);
 #endif
@@ -816,10 +1349,33 @@ static void sc_tee(void)
         log_fail("tee", "pipe", -1);
         return;
     }
-    /* put some data into p1[1] */
-    write(p1[1], "data", 4);
-    ssize_t ret = syscall(SYS_tee, p1[0], p2[1], 4, 0);
-    if (ret < 0) log_fail("tee", "pipe", (int)ret);
+    /* put some data into p1[1]; bounded by the pipe capacity */
+    static char data[TEE_MAX], drain[TEE_MAX];
+    size_t want = copy_len(4), done = 0;
+    if (want > TEE_MAX)
+        want = TEE_MAX;
+    memset(data, 'd', want);
+    write(p1[1], data, want);
+
+    int calls = 0, retries = 0;
+    double t0 = now_sec();
+    while (done < want) {
+        ssize_t ret = syscall(SYS_tee, p1[0], p2[1], want - done, 0);
+        calls++;
+        if (ret < 0) {
+            log_fail("tee", "pipe", (int)ret);
+            break;
+        }
+        if (ret == 0)
+            break;
+        /* tee does not consume: drop the duplicated bytes from both pipes */
+        read(p1[0], drain, ret);
+        read(p2[0], drain, ret);
+        done += ret;
+        if (done < want)
+            retries++;
+    }
+    xfer_report("tee", done, calls, retries, t0);
     close(p1[0]); close(p1[1]);
     close(p2[0]); close(p2[1]);
 #else
@@ -850,7 +1406,7 @@ static void sc_unlink(void)
 static void sc_unlinkat(void)
 {
     int dfd = open("tmp", O_RDONLY);
-    if (dfd < 0) return;
+    if (dfd < 0) { setup_failed(); return; }
     int fd = openat(dfd, "unlink_me", O_CREAT | O_WRONLY | O_TRUNC, 0600);
     if (fd >= 0) {
         write(fd, "again", 5);
@@ -864,8 +1420,8 @@ static void sc_unlinkat(void)
 /* 59: utime */
 static void sc_utime(void)
 {
-    int ret = utime("file_ok.txt", NULL);
-    if (ret < 0) log_fail("utime", "file_ok.txt", ret);
+    int ret = utime(target_file(), NULL);
+    if (ret < 0) log_fail("utime", target_file(), ret);
 }
 
 /* 60: utimensat */
@@ -875,8 +1431,8 @@ static void sc_utimensat(void)
     struct timespec ts[2];
     clock_gettime(CLOCK_REALTIME, &ts[0]);
     ts[1] = ts[0];
-    int ret = syscall(SYS_utimensat, AT_FDCWD, "file_ok.txt", ts, 0);
-    if (ret < 0) log_fail("utimensat", "file_ok.txt", ret);
+    int ret = syscall(SYS_utimensat, AT_FDCWD, target_file(), ts, 0);
+    if (ret < 0) log_fail("utimensat", target_file(), ret);
 #else
     log_fail("utimensat", "unavailable", -1);
 #endif
@@ -888,8 +1444,8 @@ static void sc_utimes(void)
     struct timeval tv[2];
     gettimeofday(&tv[0], NULL);
     tv[1] = tv[0];
-    int ret = utimes("file_ok.txt", tv);
-    if (ret < 0) log_fail("utimes", "file_ok.txt", ret);
+    int ret = utimes(target_file(), tv);
+    if (ret < 0) log_fail("utimes", target_file(), ret);
 }
 
 /* 62: vmsplice */
@@ -916,112 +1472,2038 @@ static void sc_vmsplice(void)
 }
 
 /* ============================================================
-   DISPATCH TABLE
+   DATA-PATH SCENARIOS — STREAMING I/O WITH THROUGHPUT
    ============================================================ */
 
-typedef void (*sc_fn)(void);
+static char *pool[POOL_MAX];
 
-static sc_fn dispatch[] = {
-    sc_access,          /* 0  access */
-    sc_chdir,           /* 1  chdir */
-    sc_chmod,           /* 2  chmod */
-    sc_chown,           /* 3  chown */
-    sc_close,           /* 4  close */
-    sc_copy_file_range, /* 5  copy_file_range */
-    sc_faccessat2,      /* 6  faccessat2 */
-    sc_fallocate,       /* 7  fallocate */
-    sc_fchdir,          /* 8  fchdir */
-    sc_fchmod,          /* 9  fchmod */
-    sc_fchmodat,        /* 10 fchmodat */
-    sc_fchown,          /* 11 fchown */
-    sc_fchownat,        /* 12 fchownat */
-    sc_fdatasync,       /* 13 fdatasync */
-    sc_fsconfig,        /* 14 fsconfig (stub) */
-    sc_fsetxattr,       /* 15 fsetxattr */
-    sc_fsmount,         /* 16 fsmount (stub) */
-    sc_fsopen,          /* 17 fsopen (stub) */
-    sc_fspick,          /* 18 fspick (stub) */
-    sc_fstat,           /* 19 fstat */
-    sc_fstatfs,         /* 20 fstatfs */
-    sc_fsync,           /* 21 fsync */
-    sc_ftruncate,       /* 22 ftruncate */
-    sc_getdents,        /* 23 getdents */
-    sc_getdents64,      /* 24 getdents64 */
-    sc_lchown,          /* 25 lchown */
-    sc_link,            /* 26 link */
-    sc_linkat,          /* 27 linkat */
-    sc_lstat,           /* 28 lstat */
-    sc_mkdir,           /* 29 mkdir */
-    sc_mkdirat,         /* 30 mkdirat */
-    sc_mknod,           /* 31 mknod */
-    sc_mknodat,         /* 32 mknodat */
-    sc_mount,           /* 33 mount (stub) */
-    sc_mount_setattr,   /* 34 mount_setattr (stub) */
-    sc_open,            /* 35 open */
-    sc_open_by_handle_at, /* 36 open_by_handle_at (stub) */
-    sc_open_tree,       /* 37 open_tree */
-    sc_openat,          /* 38 openat */
-    sc_openat2,         /* 39 openat2 */
-    sc_readahead,       /* 40 readahead */
-    sc_readlink,        /* 41 readlink */
-    sc_readlinkat,      /* 42 readlinkat */
-    sc_rename,          /* 43 rename */
-    sc_renameat,        /* 44 renameat */
-    sc_renameat2,       /* 45 renameat2 */
-    sc_rmdir,           /* 46 rmdir */
-    sc_sendfile,        /* 47 sendfile */
-    sc_splice,          /* 48 splice */
-    sc_stat,            /* 49 stat */
-    sc_statfs,          /* 50 statfs */
-    sc_statx,           /* 51 statx */
-    sc_symlink,         /* 52 symlink */
-    sc_symlinkat,       /* 53 symlinkat */
-    sc_sync,            /* 54 sync */
-    sc_tee,             /* 55 tee */
-    sc_truncate,        /* 56 truncate */
-    sc_unlink,          /* 57 unlink */
-    sc_unlinkat,        /* 58 unlinkat */
-    sc_utime,           /* 59 utime */
-    sc_utimensat,       /* 60 utimensat */
-    sc_utimes,          /* 61 utimes */
-    sc_vmsplice         /* 62 vmsplice */
-};
+/* Allocate the aligned buffer pool and lay down the stream file once. */
+static int stream_setup(void)
+{
+    static int ready;
+    if (ready)
+        return 0;
 
+    for (int i = 0; i < opt.pool_bufs; i++) {
+        if (posix_memalign((void **)&pool[i], STREAM_ALIGN, opt.block_size)) {
+            log_fail("stream", "posix_memalign", -1);
+            return -1;
+        }
+        memset(pool[i], 'S', opt.block_size);
+    }
 
-/* ============================================================
-   MAIN
-   ============================================================ */
+    /* Populate through the page cache so read modes always have data */
+    int fd = open(STREAM_FILE, O_CREAT | O_WRONLY | O_TRUNC, 0600);
+    if (fd < 0) {
+        log_fail("stream", "create " STREAM_FILE, fd);
+        return -1;
+    }
+    for (size_t off = 0; off < opt.file_size; off += opt.block_size) {
+        size_t n = opt.file_size - off < opt.block_size
+                 ? opt.file_size - off : opt.block_size;
+        if (write(fd, pool[0], n) < 0) {
+            log_fail("stream", "populate " STREAM_FILE, -1);
+            close(fd);
+            return -1;
+        }
+    }
+    fsync(fd);
+    close(fd);
 
-int main(int argc, char **argv)
+    ready = 1;
+    return 0;
+}
+
+static int stream_open(int flags)
 {
-    if (argc < 2) {
-        usage();
-        return 1;
+    if (opt.direct)
+        flags |= O_DIRECT;
+    return open(STREAM_FILE, flags, 0600);
+}
+
+static size_t stream_chunk(size_t done)
+{
+    size_t left = opt.file_size - done;
+    return left < opt.block_size ? left : opt.block_size;
+}
+
+/* Fill iov[] from the pool to cover at most `left` bytes; *total = iov sum */
+static int stream_iov(struct iovec *iov, size_t left, size_t *total)
+{
+    int cnt = 0;
+    *total = 0;
+    while (cnt < opt.pool_bufs && left > 0) {
+        size_t n = left < opt.block_size ? left : opt.block_size;
+        iov[cnt].iov_base = pool[cnt];
+        iov[cnt].iov_len = n;
+        *total += n;
+        left -= n;
+        cnt++;
     }
+    return cnt;
+}
 
-    char *arg = NULL;
-    if (strncmp(argv[1], "--mode=", 7) == 0)
-        arg = argv[1] + 7;
-    else {
-        usage();
-        return 1;
+/* fsync after every opt.fsync_every blocks; nonzero return aborts the pass */
+static int stream_sync(int fd, unsigned long blocks)
+{
+    if (opt.fsync_every <= 0 || blocks % opt.fsync_every != 0)
+        return 0;
+    int ret = fsync(fd);
+    if (ret < 0)
+        log_fail("fsync", STREAM_FILE, ret);
+    return ret;
+}
+
+static void stream_report(const char *sc, size_t bytes, int retries, double t0)
+{
+    static size_t total_bytes;
+    static double total_secs;
+
+    double secs = now_sec() - t0;
+    total_bytes += bytes;
+    total_secs += secs;
+
+    printf("[SERVER] %s THROUGHPUT bytes=%zu retries=%d secs=%.6f "
+           "MBps=%.2f avg_MBps=%.2f\n",
+           sc, bytes, retries, secs,
+           secs > 0 ? bytes / secs / 1e6 : 0.0,
+           total_secs > 0 ? total_bytes / total_secs / 1e6 : 0.0);
+    fflush(stdout);
+}
+
+/* 63: read */
+static void sc_read(void)
+{
+    if (stream_setup() < 0) return;
+    int fd = stream_open(O_RDONLY);
+    if (fd < 0) {
+        log_fail("read", "open " STREAM_FILE, fd);
+        return;
     }
+    size_t done = 0;
+    int retries = 0;
+    double t0 = now_sec();
+    while (done < opt.file_size) {
+        size_t n = stream_chunk(done);
+        ssize_t ret = read(fd, pool[0], n);
+        if (ret < 0) {
+            log_fail("read", STREAM_FILE, (int)ret);
+            break;
+        }
+        if (ret == 0)
+            break;
+        done += ret;
+        if ((size_t)ret < n)
+            retries++;
+    }
+    stream_report("read", done, retries, t0);
+    close(fd);
+}
 
-    int idx = mode_index(arg);
-    if (idx < 0) {
-        usage();
-        return 1;
+/* 64: write */
+static void sc_write(void)
+{
+    if (stream_setup() < 0) return;
+    int fd = stream_open(O_CREAT | O_WRONLY);
+    if (fd < 0) {
+        log_fail("write", "open " STREAM_FILE, fd);
+        return;
     }
+    size_t done = 0;
+    unsigned long blocks = 0;
+    int retries = 0;
+    double t0 = now_sec();
+    while (done < opt.file_size) {
+        size_t n = stream_chunk(done);
+        ssize_t ret = write(fd, pool[blocks % opt.pool_bufs], n);
+        if (ret < 0) {
+            log_fail("write", STREAM_FILE, (int)ret);
+            break;
+        }
+        done += ret;
+        if ((size_t)ret < n)
+            retries++;
+        if (stream_sync(fd, ++blocks) < 0)
+            break;
+    }
+    stream_report("write", done, retries, t0);
+    close(fd);
+}
 
-    printf("server PID: %d\n", getpid());
-    printf("mode=%s\n", arg);
-    fflush(stdout);
+/* 65: pread64 */
+static void sc_pread64(void)
+{
+    if (stream_setup() < 0) return;
+    int fd = stream_open(O_RDONLY);
+    if (fd < 0) {
+        log_fail("pread64", "open " STREAM_FILE, fd);
+        return;
+    }
+    size_t done = 0;
+    unsigned long blocks = 0;
+    int retries = 0;
+    double t0 = now_sec();
+    while (done < opt.file_size) {
+        size_t n = stream_chunk(done);
+        ssize_t ret = pread(fd, pool[blocks++ % opt.pool_bufs], n, (off_t)done);
+        if (ret < 0) {
+            log_fail("pread64", STREAM_FILE, (int)ret);
+            break;
+        }
+        if (ret == 0)
+            break;
+        done += ret;
+        if ((size_t)ret < n)
+            retries++;
+    }
+    stream_report("pread64", done, retries, t0);
+    close(fd);
+}
 
-    sandbox_init();
+/* 66: pwritev */
+static void sc_pwritev(void)
+{
+    if (stream_setup() < 0) return;
+    int fd = stream_open(O_CREAT | O_WRONLY);
+    if (fd < 0) {
+        log_fail("pwritev", "open " STREAM_FILE, fd);
+        return;
+    }
+    struct iovec iov[POOL_MAX];
+    size_t done = 0;
+    unsigned long calls = 0;
+    int retries = 0;
+    double t0 = now_sec();
+    while (done < opt.file_size) {
+        size_t n;
+        int cnt = stream_iov(iov, opt.file_size - done, &n);
+        ssize_t ret = pwritev(fd, iov, cnt, (off_t)done);
+        if (ret < 0) {
+            log_fail("pwritev", STREAM_FILE, (int)ret);
+            break;
+        }
+        done += ret;
+        if ((size_t)ret < n)
+            retries++;
+        if (stream_sync(fd, ++calls) < 0)
+            break;
+    }
+    stream_report("pwritev", done, retries, t0);
+    close(fd);
+}
 
-    while (1) {
-        dispatch[idx]();
-        usleep(200000); /* 200 ms */
+/* 67: preadv2 */
+static void sc_preadv2(void)
+{
+    if (stream_setup() < 0) return;
+    int fd = stream_open(O_RDONLY);
+    if (fd < 0) {
+        log_fail("preadv2", "open " STREAM_FILE, fd);
+        return;
+    }
+    struct iovec iov[POOL_MAX];
+    size_t done = 0;
+    int retries = 0;
+    double t0 = now_sec();
+    while (done < opt.file_size) {
+        size_t n;
+        int cnt = stream_iov(iov, opt.file_size - done, &n);
+        ssize_t ret = preadv2(fd, iov, cnt, (off_t)done, 0);
+        if (ret < 0) {
+            log_fail("preadv2", STREAM_FILE, (int)ret);
+            break;
+        }
+        if (ret == 0)
+            break;
+        done += ret;
+        if ((size_t)ret < n)
+            retries++;
+    }
+    stream_report("preadv2", done, retries, t0);
+    close(fd);
+}
+
+/* ============================================================
+   MEMORY-MAPPED MODES
+   ============================================================ */
+
+#define MMAP_FILE    "tmp/mmap.bin"
+#define MAP_STRIDE  1000003     /* prime: i * stride % n visits every page */
+
+static size_t map_page;
+static size_t map_len;          /* --map-size rounded down to pages */
+
+/*
+ * A fault the kernel cannot satisfy (an injected filemap_fault error, a
+ * truncated file) raises SIGBUS. While a pass is armed the handler counts
+ * it and jumps back into map_touch(), which logs it as a FAIL.
+ */
+static sigjmp_buf map_jmp;
+static volatile sig_atomic_t map_armed;
+static volatile unsigned long map_sigbus;
+
+static void on_sigbus(int sig, siginfo_t *si, void *uc)
+{
+    (void)si;
+    (void)uc;
+    if (!map_armed) {
+        signal(sig, SIG_DFL);
+        raise(sig);
+        return;
+    }
+    map_sigbus++;
+    siglongjmp(map_jmp, 1);
+}
+
+static int map_setup(void)
+{
+    static int ready;
+    if (ready)
+        return 0;
+
+    map_page = (size_t)sysconf(_SC_PAGESIZE);
+    map_len = opt.map_size / map_page * map_page;
+    fill_file(MMAP_FILE, 'M', map_len);
+    struct stat st;
+    if (stat(MMAP_FILE, &st) < 0 || (size_t)st.st_size < map_len) {
+        log_fail("mmap", "create " MMAP_FILE, -1);
+        return -1;
     }
+
+    struct sigaction sa = { .sa_sigaction = on_sigbus,
+                            .sa_flags = SA_SIGINFO };
+    sigaction(SIGBUS, &sa, NULL);
+    ready = 1;
+    return 0;
 }
 
+/* Map MMAP_FILE shared read/write; NULL (logged) on failure */
+static char *map_open(size_t len, int *fdp)
+{
+    int fd = open(MMAP_FILE, O_RDWR);
+    if (fd < 0) {
+        log_fail("open", MMAP_FILE, fd);
+        return NULL;
+    }
+    if (opt.map_cold) {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    }
+    char *base = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+        log_fail("mmap", MMAP_FILE, -1);
+        close(fd);
+        return NULL;
+    }
+    *fdp = fd;
+    return base;
+}
+
+static size_t map_order(size_t i, size_t n)
+{
+    switch (opt.map_pattern) {
+    case MAP_REVERSE: return n - 1 - i;
+    case MAP_RANDOM:  return i * MAP_STRIDE % n;
+    default:          return i;
+    }
+}
+
+/*
+ * Visit every page of [base, base + len) in --map-pattern order, reading
+ * it or, with `dirty`, writing it. Returns the pages touched before the
+ * pass finished or a SIGBUS ended it.
+ */
+static size_t map_touch(const char *sc, char *base, size_t len, int dirty)
+{
+    volatile size_t i = 0;
+    volatile char sink;
+
+    if (sigsetjmp(map_jmp, 1)) {
+        char detail[64];
+        map_armed = 0;
+        snprintf(detail, sizeof(detail), "SIGBUS page=%zu",
+                 map_order(i, len / map_page));
+        errno = EFAULT;         /* what a syscall touching the page gets */
+        log_fail(sc, detail, -1);
+        return i;
+    }
+    /* not live across sigsetjmp(), so it cannot be clobbered */
+    size_t n = len / map_page;
+    map_armed = 1;
+    for (; i < n; i++) {
+        char *pg = base + map_order(i, n) * map_page;
+        if (dirty)
+            *pg = (char)i;
+        else
+            sink = *(volatile char *)pg;
+    }
+    map_armed = 0;
+    (void)sink;
+    return n;
+}
+
+struct map_mark {
+    double t0;
+    long   minflt;
+    long   majflt;
+    unsigned long sigbus;
+};
+
+static void map_begin(struct map_mark *m)
+{
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    m->minflt = ru.ru_minflt;
+    m->majflt = ru.ru_majflt;
+    m->sigbus = map_sigbus;
+    m->t0 = now_sec();
+}
+
+/* Page-fault throughput of one pass: faults/s and MB/s of pages touched */
+static void map_report(const char *sc, size_t pages, const struct map_mark *m)
+{
+    struct rusage ru;
+    double secs = now_sec() - m->t0;
+    getrusage(RUSAGE_SELF, &ru);
+    long faults = (ru.ru_minflt - m->minflt) + (ru.ru_majflt - m->majflt);
+
+    printf("[SERVER] %s FAULTS pages=%zu minflt=%ld majflt=%ld sigbus=%lu "
+           "sigbus_total=%lu secs=%.6f faults_per_sec=%.0f MBps=%.2f\n",
+           sc, pages, ru.ru_minflt - m->minflt, ru.ru_majflt - m->majflt,
+           map_sigbus - m->sigbus, map_sigbus, secs,
+           secs > 0 ? faults / secs : 0.0,
+           secs > 0 ? pages * map_page / secs / 1e6 : 0.0);
+    fflush(stdout);
+    if (metrics)
+        METRIC_ADD(sigbus, map_sigbus - m->sigbus);
+}
+
+/* 68: mmap */
+static void sc_mmap(void)
+{
+    if (map_setup() < 0) return;
+    struct map_mark m;
+    map_begin(&m);
+    int fd;
+    char *base = map_open(map_len, &fd);
+    if (!base) return;
+    size_t pages = map_touch("mmap", base, map_len, opt.map_write);
+    munmap(base, map_len);
+    close(fd);
+    map_report("mmap", pages, &m);
+}
+
+/* 69: msync — dirty the mapping, then write it back synchronously */
+static void sc_msync(void)
+{
+    if (map_setup() < 0) return;
+    struct map_mark m;
+    map_begin(&m);
+    int fd;
+    char *base = map_open(map_len, &fd);
+    if (!base) return;
+    size_t pages = map_touch("msync", base, map_len, 1);
+    int ret = msync(base, map_len, MS_SYNC);
+    if (ret < 0) log_fail("msync", MMAP_FILE, ret);
+    munmap(base, map_len);
+    close(fd);
+    map_report("msync", pages, &m);
+}
+
+/* 70: madvise — readahead hint before the pass, drop the pages after */
+static void sc_madvise(void)
+{
+    if (map_setup() < 0) return;
+    struct map_mark m;
+    map_begin(&m);
+    int fd;
+    char *base = map_open(map_len, &fd);
+    if (!base) return;
+    int ret = madvise(base, map_len, MADV_WILLNEED);
+    if (ret < 0) log_fail("madvise", "MADV_WILLNEED", ret);
+    size_t pages = map_touch("madvise", base, map_len, opt.map_write);
+    ret = madvise(base, map_len, MADV_DONTNEED);
+    if (ret < 0) log_fail("madvise", "MADV_DONTNEED", ret);
+    munmap(base, map_len);
+    close(fd);
+    map_report("madvise", pages, &m);
+}
+
+/* 71: mremap — touch half the file, grow the mapping, touch all of it */
+static void sc_mremap(void)
+{
+    if (map_setup() < 0) return;
+    struct map_mark m;
+    map_begin(&m);
+    size_t half = map_len / 2 / map_page * map_page;
+    if (half == 0)
+        half = map_page;
+    int fd;
+    char *base = map_open(half, &fd);
+    if (!base) return;
+    size_t pages = map_touch("mremap", base, half, opt.map_write);
+    char *grown = mremap(base, half, map_len, MREMAP_MAYMOVE);
+    if (grown == MAP_FAILED) {
+        log_fail("mremap", MMAP_FILE, -1);
+        munmap(base, half);
+    } else {
+        pages += map_touch("mremap", grown, map_len, opt.map_write);
+        munmap(grown, map_len);
+    }
+    close(fd);
+    map_report("mremap", pages, &m);
+}
+
+/* ============================================================
+   LATENCY RECORDING
+   ============================================================ */
+
+/*
+ * Log-linear histogram: 8 sub-buckets per power of two of nanoseconds,
+ * so any percentile is within 12.5% of the true value.
+ */
+#define LAT_SUB_BITS  3
+#define LAT_BUCKETS   (64 << LAT_SUB_BITS)
+
+struct lat_hist {
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t max_ns;
+    uint64_t bucket[LAT_BUCKETS];
+};
+
+static int lat_bucket(uint64_t ns)
+{
+    if (ns < (1u << LAT_SUB_BITS))
+        return (int)ns;
+    int msb = 63 - __builtin_clzll(ns);
+    int sub = (ns >> (msb - LAT_SUB_BITS)) & ((1 << LAT_SUB_BITS) - 1);
+    return ((msb - LAT_SUB_BITS + 1) << LAT_SUB_BITS) + sub;
+}
+
+static uint64_t lat_bucket_floor(int b)
+{
+    if (b < (1 << LAT_SUB_BITS))
+        return b;
+    int shift = (b >> LAT_SUB_BITS) - 1;
+    uint64_t sub = b & ((1 << LAT_SUB_BITS) - 1);
+    return ((1ull << LAT_SUB_BITS) | sub) << shift;
+}
+
+static void lat_record(struct lat_hist *h, uint64_t ns)
+{
+    h->count++;
+    h->sum_ns += ns;
+    if (ns > h->max_ns)
+        h->max_ns = ns;
+    h->bucket[lat_bucket(ns)]++;
+}
+
+static double lat_pct_us(const struct lat_hist *h, double pct)
+{
+    uint64_t want = (uint64_t)(pct / 100.0 * h->count + 0.5), seen = 0;
+    if (want == 0)
+        want = 1;
+    for (int b = 0; b < LAT_BUCKETS; b++) {
+        seen += h->bucket[b];
+        if (seen >= want)
+            return lat_bucket_floor(b) / 1e3;
+    }
+    return h->max_ns / 1e3;
+}
+
+static void lat_report(const char *sc, const char *scope,
+                       const struct lat_hist *h)
+{
+    if (h->count == 0)
+        return;
+    printf("[SERVER] %s LATENCY scope=%s n=%llu mean_us=%.1f p50_us=%.1f "
+           "p90_us=%.1f p99_us=%.1f p999_us=%.1f max_us=%.1f\n",
+           sc, scope, (unsigned long long)h->count,
+           h->sum_ns / 1e3 / h->count,
+           lat_pct_us(h, 50), lat_pct_us(h, 90), lat_pct_us(h, 99),
+           lat_pct_us(h, 99.9), h->max_ns / 1e3);
+    fflush(stdout);
+}
+
+/* ============================================================
+   TIME TO RECOVERY
+   ============================================================ */
+
+/*
+ * A recovery episode starts at a failing iteration while the workload is
+ * steady, and ends when --ttr-k iterations in a row succeed. Its TTR runs
+ * from the start of the failing iteration to the start of the first of
+ * those successes. Lost throughput is the number of successful iterations
+ * the pre-fault window's rate predicts over the TTR, minus the successes
+ * that actually happened. Episodes are keyed by the first FAIL's scenario
+ * and errno.
+ */
+#define TTR_KEYS   32
+#define TTR_RING   1024         /* success timestamps kept for the baseline */
+
+struct ttr_key {
+    const char *sc;
+    int err;
+    struct lat_hist ttr;
+    double lost_ops;
+    unsigned long unrecovered;
+};
+
+static struct {
+    uint64_t ok_ns[TTR_RING];   /* start times of recent successes */
+    unsigned long ok_total;
+    uint64_t run_start;
+    /* the open episode, if key != NULL */
+    struct ttr_key *key;
+    uint64_t start;
+    uint64_t candidate;         /* first success of the current run */
+    double rate;                /* baseline successes per second, <0 = none */
+    unsigned long failed;
+    unsigned long ok_before;    /* successes inside the episode, before the run */
+    int ok_run;
+} ttr;
+
+static struct ttr_key ttr_keys[TTR_KEYS];
+static int ttr_nkeys;
+/* Episodes of keys beyond TTR_KEYS are followed but not reported */
+static struct ttr_key ttr_overflow;
+static unsigned long ttr_dropped;
+
+static struct ttr_key *ttr_key_of(const char *sc, int err)
+{
+    for (int i = 0; i < ttr_nkeys; i++)
+        if (ttr_keys[i].err == err && strcmp(ttr_keys[i].sc, sc) == 0)
+            return &ttr_keys[i];
+    if (ttr_nkeys == TTR_KEYS) {
+        if (ttr_dropped++ == 0)
+            fprintf(stderr, "warning: more than %d (scenario, errno) keys, "
+                    "TTR episodes of new ones are dropped\n", TTR_KEYS);
+        return &ttr_overflow;
+    }
+    ttr_keys[ttr_nkeys].sc = sc;
+    ttr_keys[ttr_nkeys].err = err;
+    return &ttr_keys[ttr_nkeys++];
+}
+
+/* Successes per second over the --ttr-window before `now`; -1 if unknown */
+static double ttr_baseline(uint64_t now)
+{
+    uint64_t window = (uint64_t)opt.ttr_window * 1000000000ull;
+    if (now - ttr.run_start < window)
+        window = now - ttr.run_start;
+    unsigned long n = 0;
+    unsigned long have = ttr.ok_total < TTR_RING ? ttr.ok_total : TTR_RING;
+    for (unsigned long i = 0; i < have; i++) {
+        uint64_t t = ttr.ok_ns[(ttr.ok_total - 1 - i) % TTR_RING];
+        if (now - t > window)
+            break;
+        n++;
+    }
+    return n && window ? n / (window / 1e9) : -1.0;
+}
+
+static void ttr_close(const char *mode, uint64_t end, int recovered)
+{
+    struct ttr_key *k = ttr.key;
+    uint64_t dt = end - ttr.start;
+    double expected = ttr.rate > 0 ? ttr.rate * dt / 1e9 : 0.0;
+    double lost = expected > ttr.ok_before ? expected - ttr.ok_before : 0.0;
+
+    if (k == &ttr_overflow) {
+        ttr.key = NULL;
+        return;
+    }
+    if (recovered) {
+        lat_record(&k->ttr, dt);
+        k->lost_ops += lost;
+    } else {
+        k->unrecovered++;
+    }
+    printf("[SERVER] %s RECOVERY sc=%s errno=%d recovered=%d ttr_ms=%.1f "
+           "failed_iters=%lu lost_ops=%.1f lost_pct=%.1f\n",
+           mode, k->sc, k->err, recovered, dt / 1e6, ttr.failed, lost,
+           expected > 0 ? 100.0 * lost / expected : 0.0);
+    fflush(stdout);
+    ttr.key = NULL;
+}
+
+/* Feed one iteration: its start time and whether it printed a FAIL */
+static void ttr_note(const char *mode, uint64_t t0, int failed)
+{
+    if (!ttr.run_start)
+        ttr.run_start = t0;
+
+    if (failed) {
+        if (!ttr.key) {
+            ttr.key = ttr_key_of(iter_fail_sc, iter_fail_errno);
+            ttr.start = t0;
+            ttr.rate = ttr_baseline(t0);
+            ttr.failed = 0;
+            ttr.ok_before = 0;
+        }
+        ttr.failed++;
+        ttr.ok_before += ttr.ok_run;
+        ttr.ok_run = 0;
+        return;
+    }
+
+    ttr.ok_ns[ttr.ok_total++ % TTR_RING] = t0;
+    if (!ttr.key)
+        return;
+    if (ttr.ok_run++ == 0)
+        ttr.candidate = t0;
+    if (ttr.ok_run >= opt.ttr_k) {
+        ttr_close(mode, ttr.candidate, 1);
+        ttr.ok_run = 0;
+    }
+}
+
+/* Exit summary: TTR distribution and mean lost throughput per key */
+static void ttr_report(const char *mode, uint64_t now)
+{
+    if (ttr.key)
+        ttr_close(mode, now, 0);
+    for (int i = 0; i < ttr_nkeys; i++) {
+        const struct ttr_key *k = &ttr_keys[i];
+        const struct lat_hist *h = &k->ttr;
+        printf("[SERVER] %s TTR sc=%s errno=%d episodes=%llu "
+               "unrecovered=%lu p50_ms=%.1f p90_ms=%.1f p99_ms=%.1f "
+               "max_ms=%.1f lost_ops_mean=%.1f\n",
+               mode, k->sc, k->err, (unsigned long long)h->count,
+               k->unrecovered,
+               h->count ? lat_pct_us(h, 50) / 1e3 : 0.0,
+               h->count ? lat_pct_us(h, 90) / 1e3 : 0.0,
+               h->count ? lat_pct_us(h, 99) / 1e3 : 0.0,
+               h->max_ns / 1e6,
+               h->count ? k->lost_ops / h->count : 0.0);
+    }
+    if (ttr_dropped)
+        printf("[SERVER] %s TTR dropped_episodes=%lu (more than %d keys)\n",
+               mode, ttr_dropped, TTR_KEYS);
+    fflush(stdout);
+}
+
+/* ============================================================
+   LIVE METRICS
+   ============================================================ */
+
+static int metrics_open(const char *path, const char *mode)
+{
+    int fd = open(path, O_CREAT | O_RDWR | O_TRUNC, 0644);
+    if (fd < 0 || ftruncate(fd, sizeof(struct metrics_shm)) < 0) {
+        perror("--metrics-shm");
+        return -1;
+    }
+    struct metrics_shm *m = mmap(NULL, sizeof(*m), PROT_READ | PROT_WRITE,
+                                 MAP_SHARED, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) {
+        perror("mmap --metrics-shm");
+        return -1;
+    }
+    m->version = METRICS_VERSION;
+    m->pid = getpid();
+    snprintf(m->mode, sizeof(m->mode), "%s", mode);
+    /* magic last: a reader that sees it sees the whole header */
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(m->magic, METRICS_MAGIC, sizeof(m->magic));
+    metrics = m;
+    return 0;
+}
+
+static void metrics_note(uint64_t ns, unsigned long fails)
+{
+    int b = 0;
+    for (uint64_t bound = 1000; b < METRICS_BUCKETS - 1 && ns > bound;
+         bound *= 10)
+        b++;
+    METRIC_ADD(iterations, 1);
+    METRIC_ADD(lat_sum_ns, ns);
+    METRIC_ADD(lat_bucket[b], 1);
+    if (fails)
+        METRIC_ADD(fail_iters, 1);
+}
+
+/* ============================================================
+   BURST WINDOWS
+   ============================================================ */
+
+/*
+ * --burst-window=FILE is the injector's burst_window parameter,
+ * "start_ns,len_ms,period_ms" on CLOCK_MONOTONIC (the clock of now_ns()).
+ * It is re-read every iteration, so manual triggers are picked up too. A
+ * window is reported once an equally long span after it has passed: the
+ * rate of successful iterations in the span before, during and after it,
+ * the FAIL lines in each, and the time from its end to the first
+ * successful iteration.
+ */
+#define BURST_RING  4096        /* iterations kept: ~13 min at 5 per second */
+
+struct burst_iter {
+    uint64_t t0;
+    unsigned long fails;
+};
+
+static struct {
+    struct burst_iter it[BURST_RING];
+    unsigned long n;
+    uint64_t start, len, period;    /* window as last read, ns */
+    uint64_t next;                  /* next window to report, 0 = none */
+} burst;
+
+static void burst_read(void)
+{
+    unsigned long long start = 0, len_ms = 0, period_ms = 0;
+    FILE *f = fopen(opt.burst_window, "r");
+    if (f) {
+        if (fscanf(f, "%llu,%llu,%llu", &start, &len_ms, &period_ms) < 2)
+            start = len_ms = period_ms = 0;
+        fclose(f);
+    }
+    uint64_t len = len_ms * 1000000ull, period = period_ms * 1000000ull;
+    if (start == burst.start && len == burst.len && period == burst.period)
+        return;
+    burst.start = start;
+    burst.len = len;
+    burst.period = period;
+    burst.next = len ? start : 0;
+}
+
+static uint64_t burst_oldest(void)
+{
+    unsigned long have = burst.n < BURST_RING ? burst.n : BURST_RING;
+    return have ? burst.it[(burst.n - have) % BURST_RING].t0 : 0;
+}
+
+/* Successful iterations per second in [a, b), and the FAIL lines there */
+static double burst_rate(uint64_t a, uint64_t b, unsigned long *fails)
+{
+    unsigned long have = burst.n < BURST_RING ? burst.n : BURST_RING;
+    unsigned long ok = 0;
+
+    *fails = 0;
+    if (a < burst_oldest())
+        a = burst_oldest();
+    for (unsigned long i = 0; i < have; i++) {
+        const struct burst_iter *e = &burst.it[(burst.n - 1 - i) % BURST_RING];
+        if (e->t0 < a)
+            break;
+        if (e->t0 >= b)
+            continue;
+        if (e->fails)
+            *fails += e->fails;
+        else
+            ok++;
+    }
+    return b > a ? ok / ((b - a) / 1e9) : 0.0;
+}
+
+static void burst_report(const char *mode, uint64_t s, uint64_t now,
+                         int partial)
+{
+    uint64_t e = s + burst.len;
+    uint64_t after = e + burst.len < now ? e + burst.len : now;
+    unsigned long fb, fd, fa;
+    double before = burst_rate(s > burst.len ? s - burst.len : 0, s, &fb);
+    double during = burst_rate(s, e < now ? e : now, &fd);
+    double post = burst_rate(e, after, &fa);
+
+    /* first success that started after the window closed */
+    double recover_ms = -1.0;
+    unsigned long have = burst.n < BURST_RING ? burst.n : BURST_RING;
+    for (unsigned long i = have; i-- > 0;) {
+        const struct burst_iter *it = &burst.it[(burst.n - 1 - i) % BURST_RING];
+        if (it->t0 >= e && !it->fails) {
+            recover_ms = (it->t0 - e) / 1e6;
+            break;
+        }
+    }
+
+    printf("[SERVER] %s BURST start_ns=%llu len_ms=%.0f before_ops=%.2f "
+           "during_ops=%.2f after_ops=%.2f before_fails=%lu "
+           "during_fails=%lu after_fails=%lu recover_ms=%.1f partial=%d\n",
+           mode, (unsigned long long)s, burst.len / 1e6, before, during,
+           post, fb, fd, fa, recover_ms, partial);
+    fflush(stdout);
+}
+
+/* Feed one iteration (start time, FAIL lines) and report finished windows */
+static void burst_note(const char *mode, uint64_t t0, unsigned long fails,
+                       uint64_t now)
+{
+    burst.it[burst.n % BURST_RING].t0 = t0;
+    burst.it[burst.n % BURST_RING].fails = fails;
+    burst.n++;
+
+    burst_read();
+    while (burst.next && now >= burst.next + 2 * burst.len) {
+        /* windows from before the ring's history have nothing to say */
+        if (burst.next + 2 * burst.len > burst_oldest())
+            burst_report(mode, burst.next, now, 0);
+        burst.next = burst.period ? burst.next + burst.period : 0;
+    }
+}
+
+/* Exit: a window that opened but whose after-span is incomplete */
+static void burst_finish(const char *mode, uint64_t now)
+{
+    if (burst.next && now > burst.next)
+        burst_report(mode, burst.next, now, 1);
+}
+
+/* ============================================================
+   SECCOMP BACKEND
+   ============================================================ */
+
+/*
+ * --seccomp=RULES fails syscalls without fs_injector.ko: no root, kprobes
+ * or matching kernel build needed. RULES is "name:errno[*max][@every][%pct]
+ * ,..." with name a syscall (or its number). The same rule set as the
+ * module's inject_errno / max_injections / inject_every, targeting this
+ * process and its children.
+ *
+ * The filter is installed on the workload thread just before the main
+ * loop, so sandbox setup is never affected. A plain rule compiles to
+ * SECCOMP_RET_ERRNO and never leaves the kernel; errno 0 matches and
+ * allows, to time the filter alone. A rule with a budget, rate or
+ * probability returns SECCOMP_RET_USER_NOTIF. A supervisor thread, started
+ * before the filter and so not subject to it, then answers with the errno
+ * or lets the call continue.
+ *
+ * BPF only sees the raw syscall number and arguments: there is no path
+ * filtering, and a rule on a syscall the libc wrapper does not use (open
+ * is openat in glibc) never matches.
+ */
+#define SECCOMP_RULES  32
+
+#if defined(__x86_64__)
+#define SECCOMP_ARCH  AUDIT_ARCH_X86_64
+#elif defined(__aarch64__)
+#define SECCOMP_ARCH  AUDIT_ARCH_AARCH64
+#endif
+
+struct sc_rule {
+    const char *text;
+    int nr;
+    int err;
+    unsigned long max;      /* *N: injections allowed, 0 = no limit */
+    unsigned long every;    /* @N: only every Nth call */
+    double pct;             /* %P: injection probability, <0 = always */
+    int notify;             /* decided by the supervisor */
+    unsigned long calls;    /* notify rules: calls seen */
+    unsigned long injected; /* notify rules: calls failed */
+};
+
+static struct sc_rule sc_rules[SECCOMP_RULES];
+static int sc_nrules;
+static int sc_listener = -1;
+
+#define SC(name)  { #name, SYS_##name }
+static const struct {
+    const char *name;
+    long nr;
+} sc_names[] = {
+    SC(chdir), SC(close), SC(fallocate), SC(fchdir), SC(fchmod), SC(fchmodat),
+    SC(fchown), SC(fchownat), SC(fdatasync), SC(fsetxattr), SC(fstat),
+    SC(fstatfs), SC(fsync), SC(ftruncate), SC(getdents64), SC(linkat),
+    SC(mkdirat), SC(mknodat), SC(mount), SC(newfstatat),
+    SC(open_by_handle_at), SC(openat), SC(readahead), SC(readlinkat),
+    SC(renameat), SC(renameat2), SC(sendfile), SC(splice), SC(statfs),
+    SC(symlinkat), SC(sync), SC(tee), SC(truncate), SC(unlinkat),
+    SC(utimensat), SC(vmsplice), SC(read), SC(write), SC(pread64),
+    SC(pwrite64), SC(readv), SC(writev), SC(preadv), SC(pwritev), SC(lseek),
+    SC(fcntl), SC(dup), SC(mmap), SC(munmap), SC(msync), SC(madvise),
+    SC(mremap),
+    /* legacy path syscalls, absent from the generic table (aarch64) */
+#ifdef SYS_access
+    SC(access),
+#endif
+#ifdef SYS_chmod
+    SC(chmod),
+#endif
+#ifdef SYS_chown
+    SC(chown),
+#endif
+#ifdef SYS_creat
+    SC(creat),
+#endif
+#ifdef SYS_getdents
+    SC(getdents),
+#endif
+#ifdef SYS_lchown
+    SC(lchown),
+#endif
+#ifdef SYS_link
+    SC(link),
+#endif
+#ifdef SYS_lstat
+    SC(lstat),
+#endif
+#ifdef SYS_mkdir
+    SC(mkdir),
+#endif
+#ifdef SYS_mknod
+    SC(mknod),
+#endif
+#ifdef SYS_open
+    SC(open),
+#endif
+#ifdef SYS_readlink
+    SC(readlink),
+#endif
+#ifdef SYS_rename
+    SC(rename),
+#endif
+#ifdef SYS_rmdir
+    SC(rmdir),
+#endif
+#ifdef SYS_stat
+    SC(stat),
+#endif
+#ifdef SYS_symlink
+    SC(symlink),
+#endif
+#ifdef SYS_unlink
+    SC(unlink),
+#endif
+#ifdef SYS_utime
+    SC(utime),
+#endif
+#ifdef SYS_utimes
+    SC(utimes),
+#endif
+#ifdef SYS_copy_file_range
+    SC(copy_file_range),
+#endif
+#ifdef SYS_faccessat2
+    SC(faccessat2),
+#endif
+#ifdef SYS_openat2
+    SC(openat2),
+#endif
+#ifdef SYS_statx
+    SC(statx),
+#endif
+#ifdef SYS_preadv2
+    SC(preadv2), SC(pwritev2),
+#endif
+#ifdef SYS_open_tree
+    SC(open_tree), SC(fsopen), SC(fsconfig), SC(fsmount), SC(fspick),
+#endif
+#ifdef SYS_mount_setattr
+    SC(mount_setattr),
+#endif
+};
+
+static int seccomp_nr(const char *name)
+{
+    char *end;
+    long nr = strtol(name, &end, 10);
+    if (*name && !*end)
+        return (int)nr;
+    for (size_t i = 0; i < sizeof(sc_names) / sizeof(sc_names[0]); i++)
+        if (strcmp(sc_names[i].name, name) == 0)
+            return (int)sc_names[i].nr;
+    return -1;
+}
+
+static int seccomp_parse(const char *spec)
+{
+    char *buf = strdup(spec), *save = NULL;
+
+    for (char *tok = strtok_r(buf, ",", &save); tok;
+         tok = strtok_r(NULL, ",", &save)) {
+        struct sc_rule *r = &sc_rules[sc_nrules];
+        if (sc_nrules == SECCOMP_RULES) {
+            fprintf(stderr, "--seccomp: more than %d rules\n", SECCOMP_RULES);
+            free(buf);
+            return -1;
+        }
+        r->text = strdup(tok);
+        r->pct = -1.0;
+
+        char *p = strchr(tok, ':');
+        if (!p)
+            goto bad;
+        *p++ = '\0';
+        r->nr = seccomp_nr(tok);
+        if (r->nr < 0)
+            goto bad;
+        r->err = (int)strtol(p, &p, 10);
+        if (r->err < 0 || r->err > 4095)
+            goto bad;
+        while (*p) {
+            char m = *p++;
+            if (m == '*')
+                r->max = strtoul(p, &p, 10);
+            else if (m == '@')
+                r->every = strtoul(p, &p, 10);
+            else if (m == '%')
+                r->pct = strtod(p, &p);
+            else
+                goto bad;
+            r->notify = 1;
+        }
+        sc_nrules++;
+    }
+    free(buf);
+    return sc_nrules ? 0 : -1;
+
+bad:
+    fprintf(stderr, "--seccomp: bad rule '%s' (name:errno[*max][@every]"
+            "[%%pct])\n", sc_rules[sc_nrules].text);
+    free((char *)sc_rules[sc_nrules].text);
+    sc_rules[sc_nrules].text = NULL;
+    free(buf);
+    return -1;
+}
+
+/* Supervisor's verdict on one notified call */
+static int seccomp_hit(struct sc_rule *r, unsigned int *seed)
+{
+    unsigned long call = __atomic_add_fetch(&r->calls, 1, __ATOMIC_RELAXED);
+
+    if (r->every > 1 && call % r->every)
+        return 0;
+    if (r->pct >= 0 &&
+        rand_r(seed) >= r->pct / 100.0 * ((double)RAND_MAX + 1))
+        return 0;
+    if (!r->err || (r->max && r->injected >= r->max))
+        return 0;
+    __atomic_add_fetch(&r->injected, 1, __ATOMIC_RELAXED);
+    return 1;
+}
+
+static void *seccomp_supervise(void *unused)
+{
+    struct seccomp_notif_sizes sz;
+    unsigned int seed = (unsigned int)getpid();
+    int fd;
+
+    (void)unused;
+    if (syscall(SYS_seccomp, SECCOMP_GET_NOTIF_SIZES, 0, &sz) < 0) {
+        perror("seccomp(GET_NOTIF_SIZES)");
+        return NULL;
+    }
+    struct seccomp_notif *req = calloc(1, sz.seccomp_notif);
+    struct seccomp_notif_resp *resp = calloc(1, sz.seccomp_notif_resp);
+
+    /* handed over without a syscall: the workload thread is filtered */
+    while ((fd = __atomic_load_n(&sc_listener, __ATOMIC_ACQUIRE)) < 0)
+        usleep(1000);
+
+    for (;;) {
+        memset(req, 0, sz.seccomp_notif);
+        if (ioctl(fd, SECCOMP_IOCTL_NOTIF_RECV, req) < 0) {
+            if (errno == EINTR || errno == ENOENT)
+                continue;
+            break;
+        }
+        memset(resp, 0, sz.seccomp_notif_resp);
+        resp->id = req->id;
+        resp->flags = SECCOMP_USER_NOTIF_FLAG_CONTINUE;
+        for (int i = 0; i < sc_nrules; i++) {
+            struct sc_rule *r = &sc_rules[i];
+            if (r->nr != req->data.nr)
+                continue;
+            if (seccomp_hit(r, &seed)) {
+                resp->flags = 0;
+                resp->error = -r->err;
+            }
+            break;
+        }
+        /* ENOENT: the caller died meanwhile */
+        ioctl(fd, SECCOMP_IOCTL_NOTIF_SEND, resp);
+    }
+    return NULL;
+}
+
+/* Compile the rules and install the filter on the calling thread */
+static int seccomp_install(void)
+{
+    struct sock_filter prog[5 + 2 * SECCOMP_RULES];
+    int n = 0, notify = 0;
+
+    if (seccomp_parse(opt.seccomp) < 0)
+        return -1;
+
+#ifdef SECCOMP_ARCH
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+                    offsetof(struct seccomp_data, arch));
+    prog[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+                    SECCOMP_ARCH, 1, 0);
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K,
+                    SECCOMP_RET_ALLOW);
+#endif
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS,
+                    offsetof(struct seccomp_data, nr));
+    for (int i = 0; i < sc_nrules; i++) {
+        const struct sc_rule *r = &sc_rules[i];
+        uint32_t action = r->notify ? SECCOMP_RET_USER_NOTIF :
+                          r->err ? SECCOMP_RET_ERRNO | (uint32_t)r->err :
+                          SECCOMP_RET_ALLOW;
+        notify |= r->notify;
+        prog[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+                        (uint32_t)r->nr, 0, 1);
+        prog[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, action);
+    }
+    prog[n++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K,
+                    SECCOMP_RET_ALLOW);
+    struct sock_fprog fprog = { .len = (unsigned short)n, .filter = prog };
+
+    pthread_t sup;
+    if (notify && pthread_create(&sup, NULL, seccomp_supervise, NULL) != 0) {
+        fprintf(stderr, "--seccomp: cannot start the supervisor\n");
+        return -1;
+    }
+    if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) < 0) {
+        perror("prctl(NO_NEW_PRIVS)");
+        return -1;
+    }
+    long fd = syscall(SYS_seccomp, SECCOMP_SET_MODE_FILTER,
+                      notify ? SECCOMP_FILTER_FLAG_NEW_LISTENER : 0, &fprog);
+    if (fd < 0) {
+        perror("seccomp(SET_MODE_FILTER)");
+        return -1;
+    }
+    if (notify)
+        __atomic_store_n(&sc_listener, (int)fd, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* Exit: per-rule counts (calls and injections are only known to notify) */
+static void seccomp_report(const char *mode)
+{
+    for (int i = 0; i < sc_nrules; i++) {
+        const struct sc_rule *r = &sc_rules[i];
+        printf("[SERVER] %s SECCOMP rule=%s nr=%d action=%s calls=%ld "
+               "injected=%ld\n", mode, r->text, r->nr,
+               r->notify ? "notify" : r->err ? "errno" : "allow",
+               r->notify ? (long)__atomic_load_n(&r->calls, __ATOMIC_RELAXED) : -1,
+               r->notify ? (long)__atomic_load_n(&r->injected, __ATOMIC_RELAXED) : -1);
+    }
+    fflush(stdout);
+}
+
+/* ============================================================
+   KERNEL COVERAGE (kcov)
+   ============================================================ */
+
+/*
+ * Each iteration is traced with KCOV_TRACE_PC. Edges are hashed
+ * (previous PC, PC) pairs kept in a bitmap; an iteration's new edges are
+ * the bits it set first. With --kcov-baseline the edges seen by then are
+ * frozen as the workload's own set, and every later iteration also lists
+ * its distinct edges outside it, so the controller can credit each errno
+ * with everything it reached, not only what no earlier errno had.
+ */
+#define KCOV_PATH        "/sys/kernel/debug/kcov"
+#define KCOV_COVER_SIZE  (256 << 10)
+#define KCOV_EDGE_BITS   24
+
+static struct {
+    int fd;
+    unsigned long *cover;
+    uint8_t *edges;             /* 1 << KCOV_EDGE_BITS bits */
+    uint64_t total;
+    uint8_t *base;              /* edges when the baseline was frozen */
+    uint8_t *seen;              /* this iteration's edges outside base */
+    uint32_t *out;              /* ... as a list, kcov.nout long */
+    size_t nout;
+} kcov = { .fd = -1 };
+
+static int kcov_open(void)
+{
+    kcov.fd = open(KCOV_PATH, O_RDWR);
+    if (kcov.fd < 0) {
+        perror("open " KCOV_PATH);
+        return -1;
+    }
+    if (ioctl(kcov.fd, KCOV_INIT_TRACE, KCOV_COVER_SIZE) < 0) {
+        perror("KCOV_INIT_TRACE");
+        return -1;
+    }
+    kcov.cover = mmap(NULL, KCOV_COVER_SIZE * sizeof(unsigned long),
+                      PROT_READ | PROT_WRITE, MAP_SHARED, kcov.fd, 0);
+    kcov.edges = calloc(1, (1u << KCOV_EDGE_BITS) / 8);
+    if (opt.kcov_baseline > 0) {
+        kcov.seen = calloc(1, (1u << KCOV_EDGE_BITS) / 8);
+        kcov.out = malloc(KCOV_COVER_SIZE * sizeof(*kcov.out));
+    }
+    if (kcov.cover == MAP_FAILED || !kcov.edges ||
+        (opt.kcov_baseline > 0 && (!kcov.seen || !kcov.out))) {
+        perror("kcov buffers");
+        return -1;
+    }
+    if (ioctl(kcov.fd, KCOV_ENABLE, KCOV_TRACE_PC) < 0) {
+        perror("KCOV_ENABLE");
+        return -1;
+    }
+    return 0;
+}
+
+static void kcov_begin(void)
+{
+    __atomic_store_n(&kcov.cover[0], 0, __ATOMIC_RELAXED);
+}
+
+/*
+ * New edges since kcov_begin(). Once the baseline is frozen, the distinct
+ * edges outside it are left in kcov.out.
+ */
+static uint64_t kcov_end(void)
+{
+    unsigned long n = __atomic_load_n(&kcov.cover[0], __ATOMIC_RELAXED);
+    unsigned long prev = 0;
+    uint64_t fresh = 0;
+
+    if (n > KCOV_COVER_SIZE - 1)
+        n = KCOV_COVER_SIZE - 1;
+    kcov.nout = 0;
+    for (unsigned long i = 0; i < n; i++) {
+        unsigned long pc = kcov.cover[i + 1];
+        uint64_t h = (prev * 0x9e3779b97f4a7c15ull) ^ pc;
+        uint8_t bit;
+        h = (h * 0xff51afd7ed558ccdull) >> (64 - KCOV_EDGE_BITS);
+        bit = 1u << (h & 7);
+        if (!(kcov.edges[h >> 3] & bit)) {
+            kcov.edges[h >> 3] |= bit;
+            fresh++;
+        }
+        if (kcov.base && !(kcov.base[h >> 3] & bit) &&
+            !(kcov.seen[h >> 3] & bit)) {
+            kcov.seen[h >> 3] |= bit;
+            kcov.out[kcov.nout++] = (uint32_t)h;
+        }
+        prev = pc;
+    }
+    for (size_t i = 0; i < kcov.nout; i++)
+        kcov.seen[kcov.out[i] >> 3] = 0;
+    kcov.total += fresh;
+    return fresh;
+}
+
+/* Freeze the edges seen so far as the workload's own */
+static int kcov_freeze(void)
+{
+    size_t len = (1u << KCOV_EDGE_BITS) / 8;
+
+    kcov.base = malloc(len);
+    if (!kcov.base)
+        return -1;
+    memcpy(kcov.base, kcov.edges, len);
+    return 0;
+}
+
+static volatile sig_atomic_t stop_requested;
+
+static void on_stop(int sig)
+{
+    (void)sig;
+    stop_requested = 1;
+}
+
+/* ============================================================
+   DISPATCH TABLE
+   ============================================================ */
+
+typedef void (*sc_fn)(void);
+
+static sc_fn dispatch[] = {
+    sc_access,          /* 0  access */
+    sc_chdir,           /* 1  chdir */
+    sc_chmod,           /* 2  chmod */
+    sc_chown,           /* 3  chown */
+    sc_close,           /* 4  close */
+    sc_copy_file_range, /* 5  copy_file_range */
+    sc_faccessat2,      /* 6  faccessat2 */
+    sc_fallocate,       /* 7  fallocate */
+    sc_fchdir,          /* 8  fchdir */
+    sc_fchmod,          /* 9  fchmod */
+    sc_fchmodat,        /* 10 fchmodat */
+    sc_fchown,          /* 11 fchown */
+    sc_fchownat,        /* 12 fchownat */
+    sc_fdatasync,       /* 13 fdatasync */
+    sc_fsconfig,        /* 14 fsconfig (stub) */
+    sc_fsetxattr,       /* 15 fsetxattr */
+    sc_fsmount,         /* 16 fsmount (stub) */
+    sc_fsopen,          /* 17 fsopen (stub) */
+    sc_fspick,          /* 18 fspick (stub) */
+    sc_fstat,           /* 19 fstat */
+    sc_fstatfs,         /* 20 fstatfs */
+    sc_fsync,           /* 21 fsync */
+    sc_ftruncate,       /* 22 ftruncate */
+    sc_getdents,        /* 23 getdents */
+    sc_getdents64,      /* 24 getdents64 */
+    sc_lchown,          /* 25 lchown */
+    sc_link,            /* 26 link */
+    sc_linkat,          /* 27 linkat */
+    sc_lstat,           /* 28 lstat */
+    sc_mkdir,           /* 29 mkdir */
+    sc_mkdirat,         /* 30 mkdirat */
+    sc_mknod,           /* 31 mknod */
+    sc_mknodat,         /* 32 mknodat */
+    sc_mount,           /* 33 mount (stub) */
+    sc_mount_setattr,   /* 34 mount_setattr (stub) */
+    sc_open,            /* 35 open */
+    sc_open_by_handle_at, /* 36 open_by_handle_at (stub) */
+    sc_open_tree,       /* 37 open_tree */
+    sc_openat,          /* 38 openat */
+    sc_openat2,         /* 39 openat2 */
+    sc_readahead,       /* 40 readahead */
+    sc_readlink,        /* 41 readlink */
+    sc_readlinkat,      /* 42 readlinkat */
+    sc_rename,          /* 43 rename */
+    sc_renameat,        /* 44 renameat */
+    sc_renameat2,       /* 45 renameat2 */
+    sc_rmdir,           /* 46 rmdir */
+    sc_sendfile,        /* 47 sendfile */
+    sc_splice,          /* 48 splice */
+    sc_stat,            /* 49 stat */
+    sc_statfs,          /* 50 statfs */
+    sc_statx,           /* 51 statx */
+    sc_symlink,         /* 52 symlink */
+    sc_symlinkat,       /* 53 symlinkat */
+    sc_sync,            /* 54 sync */
+    sc_tee,             /* 55 tee */
+    sc_truncate,        /* 56 truncate */
+    sc_unlink,          /* 57 unlink */
+    sc_unlinkat,        /* 58 unlinkat */
+    sc_utime,           /* 59 utime */
+    sc_utimensat,       /* 60 utimensat */
+    sc_utimes,          /* 61 utimes */
+    sc_vmsplice,        /* 62 vmsplice */
+    sc_read,            /* 63 read */
+    sc_write,           /* 64 write */
+    sc_pread64,         /* 65 pread64 */
+    sc_pwritev,         /* 66 pwritev */
+    sc_preadv2,         /* 67 preadv2 */
+    sc_mmap,            /* 68 mmap */
+    sc_msync,           /* 69 msync */
+    sc_madvise,         /* 70 madvise */
+    sc_mremap           /* 71 mremap */
+};
+
+
+/* ============================================================
+   SCALE SWEEP
+   ============================================================ */
+
+#define SCALE_MAX  16
+
+/* Cascade: FAIL lines per iteration, and how many iterations had any */
+struct cascade {
+    unsigned long iters;
+    unsigned long fail_iters;
+    unsigned long fails;
+    unsigned long max;
+};
+
+static void cascade_note(struct cascade *c, unsigned long fails)
+{
+    c->iters++;
+    c->fails += fails;
+    if (fails)
+        c->fail_iters++;
+    if (fails > c->max)
+        c->max = fails;
+}
+
+/* "1000,100000,1000000" -> out[]; returns the count or -1 */
+static int parse_list(const char *s, long *out)
+{
+    int n = 0;
+    while (*s) {
+        char *end;
+        if (n == SCALE_MAX)
+            return -1;
+        out[n++] = strtol(s, &end, 10);
+        if (end == s || out[n - 1] < 0 || (*end && *end != ','))
+            return -1;
+        s = *end ? end + 1 : end;
+    }
+    return n;
+}
+
+/*
+ * --scale-entries / --scale-depth: run `iters` iterations at every
+ * (entries, depth) level, growing the sandbox in between, and print one
+ * SCALE line per level so latency and cascade can be read off against
+ * directory size and path depth.
+ */
+static int scale_sweep(int idx, const char *sc, const long *entries, int ne,
+                       const long *depths, int nd, int iters)
+{
+    static struct lat_hist h;
+
+    for (int e = 0; e < ne && !stop_requested; e++) {
+        for (int d = 0; d < nd && !stop_requested; d++) {
+            opt.dir_entries = entries[e];
+            opt.path_depth = (int)depths[d];
+            if (sandbox_scale() < 0)
+                return 1;
+
+            struct cascade c = { 0 };
+            memset(&h, 0, sizeof(h));
+            scan_calls = 0;
+            for (int i = 0; i < iters && !stop_requested; i++) {
+                unsigned long f0 = fail_count;
+                uint64_t t0 = now_ns();
+                dispatch[idx]();
+                lat_record(&h, now_ns() - t0);
+                cascade_note(&c, fail_count - f0);
+                usleep(200000); /* 200 ms */
+            }
+            if (h.count == 0)
+                continue;
+            printf("[SERVER] %s SCALE entries=%ld depth=%d n=%llu "
+                   "p50_us=%.1f p99_us=%.1f max_us=%.1f calls_per_scan=%.1f "
+                   "fail_iters=%lu fails=%lu max_cascade=%lu\n",
+                   sc, opt.dir_entries, opt.path_depth,
+                   (unsigned long long)h.count, lat_pct_us(&h, 50),
+                   lat_pct_us(&h, 99), h.max_ns / 1e3,
+                   (double)scan_calls / h.count,
+                   c.fail_iters, c.fails, c.max);
+            fflush(stdout);
+        }
+    }
+    return 0;
+}
+
+/* ============================================================
+   ERRNO DISCOVERY
+   ============================================================ */
+
+#define DISC_DIR      "fs_discover"
+#define DISC_SANDBOX  "fs_sandbox"  /* each child's sandbox, in its own dir */
+#define DISC_TIMEOUT  10        /* seconds per scenario */
+
+static int disc_rm(const char *path, const struct stat *st, int flag,
+                   struct FTW *ftw)
+{
+    (void)st; (void)flag; (void)ftw;
+    remove(path);
+    return 0;
+}
+
+static int disc_chmod(const char *path, const struct stat *st, int flag,
+                      struct FTW *ftw)
+{
+    (void)ftw;
+    if (flag == FTW_D || flag == FTW_DNR)
+        chmod(path, 0700);
+    else if (S_ISREG(st->st_mode))
+        chmod(path, 0600);
+    return 0;
+}
+
+static void disc_rmtree(const char *path)
+{
+    nftw(path, disc_chmod, 16, FTW_PHYS | FTW_MOUNT);
+    nftw(path, disc_rm, 16, FTW_DEPTH | FTW_PHYS | FTW_MOUNT);
+}
+
+/* Replace every sandbox entry with a symlink to target (NULL = itself) */
+static void disc_relink(const char *target)
+{
+    DIR *d = opendir(".");
+    struct dirent *e;
+    if (!d)
+        return;
+    while ((e = readdir(d)) != NULL) {
+        if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, ".."))
+            continue;
+        disc_rmtree(e->d_name);
+        symlink(target ? target : e->d_name, e->d_name);
+    }
+    closedir(d);
+}
+
+static void disc_missing(void)
+{
+    DIR *d = opendir(".");
+    struct dirent *e;
+    if (!d)
+        return;
+    while ((e = readdir(d)) != NULL)
+        if (strcmp(e->d_name, ".") && strcmp(e->d_name, ".."))
+            disc_rmtree(e->d_name);
+    closedir(d);
+}
+
+static int disc_ro(const char *path, const struct stat *st, int flag,
+                   struct FTW *ftw)
+{
+    (void)st; (void)ftw;
+    if (flag == FTW_DP)
+        chmod(path, 0500);
+    else if (flag == FTW_F)
+        chmod(path, 0400);
+    return 0;
+}
+
+static void disc_readonly(void)
+{
+    nftw(".", disc_ro, 16, FTW_DEPTH | FTW_PHYS);
+}
+
+static void disc_unprivileged(void)
+{
+    /* Only meaningful for root: the sandbox is 0700 and root-owned */
+    if (geteuid() == 0 && (setgid(65534) < 0 || setuid(65534) < 0))
+        perror("setuid nobody");
+}
+
+static void disc_fd_exhaustion(void)
+{
+    struct rlimit rl = { 3, 3 };    /* stdio only */
+    setrlimit(RLIMIT_NOFILE, &rl);
+}
+
+static void disc_long_names(void)
+{
+    char name[NAME_MAX + 64];
+    memset(name, 'n', sizeof(name) - 1);
+    name[sizeof(name) - 1] = '\0';
+    disc_relink(name);
+}
+
+static void disc_loops(void)
+{
+    disc_relink(NULL);
+}
+
+static void disc_fsize_limit(void)
+{
+    struct rlimit rl = { 0, 0 };
+    signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &rl);
+}
+
+/* Mount perturbations need root; they live in a private mount namespace */
+static int disc_private_ns(void)
+{
+    if (unshare(CLONE_NEWNS) < 0 ||
+        mount(NULL, "/", NULL, MS_REC | MS_PRIVATE, NULL) < 0)
+        return -1;
+    return 0;
+}
+
+static void disc_full_fs(void)
+{
+    if (chdir("..") < 0 || disc_private_ns() < 0 ||
+        mount("tmpfs", opt.sandbox, "tmpfs", 0, "size=256k,mode=0700") < 0) {
+        perror("discover full_fs");
+        _exit(2);
+    }
+    /* Recreate the fixtures that fit on the small fs, then fill the rest */
+    sandbox_init();
+    fill_file("filler", 'F', 1 << 20);
+}
+
+static void disc_readonly_fs(void)
+{
+    if (chdir("..") < 0 || disc_private_ns() < 0 ||
+        mount(opt.sandbox, opt.sandbox, NULL, MS_BIND, NULL) < 0 ||
+        mount(NULL, opt.sandbox, NULL, MS_REMOUNT | MS_BIND | MS_RDONLY,
+              NULL) < 0 ||
+        chdir(opt.sandbox) < 0) {
+        perror("discover readonly_fs");
+        _exit(2);
+    }
+}
+
+static const struct {
+    const char *name;
+    void (*apply)(void);        /* runs inside the fresh sandbox */
+    int needs_root;
+} perturbs[] = {
+    { "none",          NULL,               0 },
+    { "missing",       disc_missing,       0 },
+    { "readonly",      disc_readonly,      0 },
+    { "unprivileged",  disc_unprivileged,  1 },
+    { "fd_exhaustion", disc_fd_exhaustion, 0 },
+    { "long_names",    disc_long_names,    0 },
+    { "loops",         disc_loops,         0 },
+    { "fsize_limit",   disc_fsize_limit,   0 },
+    { "full_fs",       disc_full_fs,       1 },
+    { "readonly_fs",   disc_readonly_fs,   1 },
+};
+
+#define PERTURB_COUNT ((int)(sizeof(perturbs) / sizeof(perturbs[0])))
+
+static void disc_print(FILE *out, const char *mode, const char *perturb,
+                       const struct disc_result *r)
+{
+    int n = 0;
+    fprintf(out, "%s %s ", mode, perturb);
+    /* an errno of the mode's own call outranks a failed side step */
+    for (int e = 1; e < DISC_ERRNOS; e++)
+        if (r->errs[e / 64] & (1ull << (e % 64)))
+            fprintf(out, "%s%d", n++ ? "," : "", e);
+    if (!n)
+        fprintf(out, "%s", !r->ran ? "timeout"
+                           : r->unexercised ? "unexercised" : "-");
+    fprintf(out, "\n");
+}
+
+/*
+ * Run each scenario (one mode, or all when mode < 0) once under each
+ * perturbation, each in its own child and sandbox, and write
+ * "mode perturbation errno,errno|-|unexercised|timeout" lines to out_path.
+ */
+static int discover(int mode, const char *out_path)
+{
+    size_t sz = sizeof(struct disc_result) * PERTURB_COUNT * MODE_COUNT;
+    struct disc_result *res = mmap(NULL, sz, PROT_READ | PROT_WRITE,
+                                   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (res == MAP_FAILED) {
+        perror("mmap");
+        return 1;
+    }
+
+    FILE *out = stdout;
+    if (out_path && !(out = fopen(out_path, "w"))) {
+        perror("fopen --discover-out");
+        return 1;
+    }
+
+    /* --sandbox=DIR moves the whole pass there (e.g. onto a filesystem
+     * under test); the children still get one sandbox each */
+    if (strcmp(opt.sandbox, DISC_SANDBOX) != 0) {
+        mkdir(opt.sandbox, 0700);
+        if (chdir(opt.sandbox) < 0) {
+            perror("chdir sandbox");
+            return 1;
+        }
+        opt.sandbox = DISC_SANDBOX;
+    }
+
+    disc_rmtree(DISC_DIR);
+    if (mkdir(DISC_DIR, 0700) < 0 || chdir(DISC_DIR) < 0) {
+        perror(DISC_DIR);
+        return 1;
+    }
+
+    for (int p = 0; p < PERTURB_COUNT; p++) {
+        if (perturbs[p].needs_root && geteuid() != 0) {
+            printf("[SERVER] DISCOVER perturbation=%s skipped (needs root)\n",
+                   perturbs[p].name);
+            continue;
+        }
+        for (int m = 0; m < MODE_COUNT; m++) {
+            if (mode >= 0 && m != mode)
+                continue;
+            struct disc_result *r = &res[p * MODE_COUNT + m];
+            char dir[64];
+            snprintf(dir, sizeof(dir), "%s.%s", perturbs[p].name, modes[m]);
+            mkdir(dir, 0700);
+
+            pid_t pid = fork();
+            if (pid == 0) {
+                if (chdir(dir) < 0)
+                    _exit(2);
+                sandbox_init();
+                if (perturbs[p].apply)
+                    perturbs[p].apply();
+                alarm(DISC_TIMEOUT);
+                disc_cur = r;
+                disc_mode = modes[m];
+                errno = 0;
+                dispatch[m]();
+                r->ran = 1;
+                _exit(0);
+            }
+            if (pid > 0)
+                waitpid(pid, NULL, 0);
+            disc_rmtree(dir);
+
+            disc_print(out, modes[m], perturbs[p].name, r);
+            fflush(out);
+        }
+        printf("[SERVER] DISCOVER perturbation=%s done\n", perturbs[p].name);
+        fflush(stdout);
+    }
+
+    if (chdir("..") == 0)
+        disc_rmtree(DISC_DIR);
+    if (out != stdout)
+        fclose(out);
+    munmap(res, sz);
+    return 0;
+}
+
+
+/* ============================================================
+   MAIN
+   ============================================================ */
+
+int main(int argc, char **argv)
+{
+    char *arg = NULL;
+    const char *discover_mode = NULL;
+    const char *discover_out = NULL;
+    const char *scale_entries = NULL;
+    const char *scale_depth = NULL;
+    int scale_iters = 100;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--mode=", 7) == 0)
+            arg = argv[i] + 7;
+        else if (strcmp(argv[i], "--discover") == 0)
+            discover_mode = "all";
+        else if (strncmp(argv[i], "--discover=", 11) == 0)
+            discover_mode = argv[i] + 11;
+        else if (strncmp(argv[i], "--discover-out=", 15) == 0)
+            discover_out = argv[i] + 15;
+        else if (strncmp(argv[i], "--block-size=", 13) == 0)
+            opt.block_size = parse_size(argv[i] + 13);
+        else if (strncmp(argv[i], "--file-size=", 12) == 0)
+            opt.file_size = parse_size(argv[i] + 12);
+        else if (strcmp(argv[i], "--direct") == 0)
+            opt.direct = 1;
+        else if (strncmp(argv[i], "--pool=", 7) == 0)
+            opt.pool_bufs = atoi(argv[i] + 7);
+        else if (strncmp(argv[i], "--fsync-every=", 14) == 0)
+            opt.fsync_every = atoi(argv[i] + 14);
+        else if (strncmp(argv[i], "--map-size=", 11) == 0)
+            opt.map_size = parse_size(argv[i] + 11);
+        else if (strcmp(argv[i], "--map-pattern=seq") == 0)
+            opt.map_pattern = MAP_SEQ;
+        else if (strcmp(argv[i], "--map-pattern=reverse") == 0)
+            opt.map_pattern = MAP_REVERSE;
+        else if (strcmp(argv[i], "--map-pattern=random") == 0)
+            opt.map_pattern = MAP_RANDOM;
+        else if (strcmp(argv[i], "--map-write") == 0)
+            opt.map_write = 1;
+        else if (strcmp(argv[i], "--map-cold") == 0)
+            opt.map_cold = 1;
+        else if (strncmp(argv[i], "--copy-size=", 12) == 0)
+            opt.copy_size = parse_size(argv[i] + 12);
+        else if (strncmp(argv[i], "--sandbox=", 10) == 0)
+            opt.sandbox = argv[i] + 10;
+        else if (strncmp(argv[i], "--lat-report=", 13) == 0)
+            opt.lat_report = atoi(argv[i] + 13);
+        else if (strncmp(argv[i], "--lat-log=", 10) == 0)
+            opt.lat_log = argv[i] + 10;
+        else if (strncmp(argv[i], "--metrics-shm=", 14) == 0)
+            opt.metrics_shm = argv[i] + 14;
+        else if (strncmp(argv[i], "--ttr-k=", 8) == 0)
+            opt.ttr_k = atoi(argv[i] + 8);
+        else if (strncmp(argv[i], "--ttr-window=", 13) == 0)
+            opt.ttr_window = atoi(argv[i] + 13);
+        else if (strncmp(argv[i], "--burst-window=", 15) == 0)
+            opt.burst_window = argv[i] + 15;
+        else if (strncmp(argv[i], "--seccomp=", 10) == 0)
+            opt.seccomp = argv[i] + 10;
+        else if (strncmp(argv[i], "--kcov-log=", 11) == 0)
+            opt.kcov_log = argv[i] + 11;
+        else if (strncmp(argv[i], "--kcov-baseline=", 16) == 0)
+            opt.kcov_baseline = atoi(argv[i] + 16);
+        else if (strncmp(argv[i], "--dir-entries=", 14) == 0)
+            opt.dir_entries = atol(argv[i] + 14);
+        else if (strncmp(argv[i], "--path-depth=", 13) == 0)
+            opt.path_depth = atoi(argv[i] + 13);
+        else if (strncmp(argv[i], "--build-jobs=", 13) == 0)
+            opt.build_jobs = atoi(argv[i] + 13);
+        else if (strncmp(argv[i], "--dirent-buf=", 13) == 0)
+            opt.dirent_buf = parse_size(argv[i] + 13);
+        else if (strncmp(argv[i], "--target-dir=", 13) == 0)
+            opt.target_dir = argv[i] + 13;
+        else if (strncmp(argv[i], "--scale-entries=", 16) == 0)
+            scale_entries = argv[i] + 16;
+        else if (strncmp(argv[i], "--scale-depth=", 14) == 0)
+            scale_depth = argv[i] + 14;
+        else if (strncmp(argv[i], "--scale-iters=", 14) == 0)
+            scale_iters = atoi(argv[i] + 14);
+        else {
+            usage();
+            return 1;
+        }
+    }
+
+    if (discover_mode) {
+        int m = strcmp(discover_mode, "all") ? mode_index(discover_mode) : -1;
+        if (m < 0 && strcmp(discover_mode, "all")) {
+            usage();
+            return 1;
+        }
+        return discover(m, discover_out);
+    }
+
+    if (!arg) {
+        usage();
+        return 1;
+    }
+
+    int idx = mode_index(arg);
+    if (idx < 0) {
+        usage();
+        return 1;
+    }
+
+    if (opt.block_size == 0 || opt.file_size == 0 ||
+        opt.pool_bufs < 1 || opt.pool_bufs > POOL_MAX) {
+        fprintf(stderr, "invalid --block-size/--file-size/--pool\n");
+        return 1;
+    }
+    if (opt.ttr_k < 1 || opt.ttr_window < 1) {
+        fprintf(stderr, "--ttr-k and --ttr-window must be positive\n");
+        return 1;
+    }
+    if (opt.map_size < (size_t)sysconf(_SC_PAGESIZE)) {
+        fprintf(stderr, "--map-size must be at least one page\n");
+        return 1;
+    }
+    if (opt.direct && (opt.block_size % STREAM_ALIGN ||
+                       opt.file_size % STREAM_ALIGN)) {
+        fprintf(stderr, "--direct needs sizes aligned to %d\n", STREAM_ALIGN);
+        return 1;
+    }
+
+    /* A single level unless a --scale-* list widens it */
+    long entries[SCALE_MAX] = { opt.dir_entries }, depths[SCALE_MAX] = {
+        opt.path_depth };
+    int ne = 1, nd = 1;
+    if (scale_entries)
+        ne = parse_list(scale_entries, entries);
+    if (scale_depth)
+        nd = parse_list(scale_depth, depths);
+    if (ne < 1 || nd < 1 || scale_iters < 1) {
+        fprintf(stderr, "invalid --scale-entries/--scale-depth/--scale-iters\n");
+        return 1;
+    }
+    for (int i = 0; i < nd; i++) {
+        if (depths[i] > DEPTH_MAX) {
+            fprintf(stderr, "--path-depth is limited to %d\n", DEPTH_MAX);
+            return 1;
+        }
+    }
+    if (opt.dir_entries < 0 || opt.path_depth < 0 || opt.dirent_buf < 512) {
+        fprintf(stderr, "invalid --dir-entries/--path-depth/--dirent-buf\n");
+        return 1;
+    }
+
+    printf("server PID: %d\n", getpid());
+    printf("mode=%s\n", arg);
+    fflush(stdout);
+
+    /* Opened before the chdir into the sandbox so relative paths work */
+    FILE *lat_log = NULL;
+    if (opt.lat_log) {
+        lat_log = fopen(opt.lat_log, "a");
+        if (!lat_log) {
+            perror("fopen --lat-log");
+            return 1;
+        }
+    }
+
+    if (opt.metrics_shm && metrics_open(opt.metrics_shm, arg) < 0)
+        return 1;
+
+    FILE *kcov_log = NULL;
+    if (opt.kcov_log) {
+        kcov_log = fopen(opt.kcov_log, "a");
+        if (!kcov_log) {
+            perror("fopen --kcov-log");
+            return 1;
+        }
+        setvbuf(kcov_log, NULL, _IOLBF, 0);
+    }
+
+    sandbox_init();
+
+    struct sigaction sa = { .sa_handler = on_stop };
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    if (scale_entries || scale_depth)
+        return scale_sweep(idx, arg, entries, ne, depths, nd, scale_iters);
+    if (sandbox_scale() < 0)
+        return 1;
+
+    /* After sandbox setup, so only the workload itself is traced */
+    if (kcov_log && kcov_open() < 0)
+        return 1;
+
+    /* Last, so that setup is never filtered */
+    if (opt.seccomp && seccomp_install() < 0)
+        return 1;
+
+    static struct lat_hist lat_total, lat_window;
+    struct cascade cascade = { 0 };
+    double next_report = now_sec() + opt.lat_report;
+    uint64_t kcov_freeze_ns = kcov_log && opt.kcov_baseline > 0
+        ? now_ns() + (uint64_t)opt.kcov_baseline * 1000000000ull : 0;
+
+    while (!stop_requested) {
+        unsigned long f0 = fail_count;
+        iter_fail_sc = NULL;
+        uint64_t t0 = now_ns();
+        if (kcov_log)
+            kcov_begin();
+        dispatch[idx]();
+        uint64_t dt = now_ns() - t0;
+
+        if (kcov_log) {
+            uint64_t fresh = kcov_end();
+            fprintf(kcov_log, "%llu,%llu,%llu", (unsigned long long)t0,
+                    (unsigned long long)kcov.total,
+                    (unsigned long long)fresh);
+            if (kcov.base) {
+                fputc(',', kcov_log);
+                for (size_t i = 0; i < kcov.nout; i++)
+                    fprintf(kcov_log, "%s%x", i ? " " : "", kcov.out[i]);
+            }
+            fputc('\n', kcov_log);
+            if (kcov_freeze_ns && t0 + dt >= kcov_freeze_ns) {
+                kcov_freeze_ns = 0;
+                if (kcov_freeze() < 0) {
+                    perror("kcov baseline");
+                    return 1;
+                }
+                fprintf(kcov_log, "# baseline edges=%llu\n",
+                        (unsigned long long)kcov.total);
+            }
+        }
+
+        lat_record(&lat_total, dt);
+        lat_record(&lat_window, dt);
+        cascade_note(&cascade, fail_count - f0);
+        ttr_note(arg, t0, fail_count != f0);
+        if (opt.burst_window)
+            burst_note(arg, t0, fail_count - f0, t0 + dt);
+        if (metrics)
+            metrics_note(dt, fail_count - f0);
+        if (lat_log)
+            fprintf(lat_log, "%llu,%llu,%lu\n", (unsigned long long)t0,
+                    (unsigned long long)dt, fail_count - f0);
+
+        if (opt.lat_report > 0 && now_sec() >= next_report) {
+            lat_report(arg, "window", &lat_window);
+            memset(&lat_window, 0, sizeof(lat_window));
+            next_report += opt.lat_report;
+        }
+
+        usleep(200000); /* 200 ms */
+    }
+
+    lat_report(arg, "total", &lat_total);
+    ttr_report(arg, now_ns());
+    if (opt.burst_window)
+        burst_finish(arg, now_ns());
+    if (opt.seccomp)
+        seccomp_report(arg);
+    printf("[SERVER] %s CASCADE iters=%lu fail_iters=%lu fails=%lu "
+           "max_cascade=%lu\n", arg, cascade.iters, cascade.fail_iters,
+           cascade.fails, cascade.max);
+    if (lat_log)
+        fclose(lat_log);
+    if (kcov_log) {
+        printf("[SERVER] %s COVERAGE edges=%llu\n", arg,
+               (unsigned long long)kcov.total);
+        fclose(kcov_log);
+    }
+    return 0;
+}
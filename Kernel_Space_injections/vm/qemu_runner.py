@@ -0,0 +1,282 @@
+#!/usr/bin/env python3
+"""
+Run (syscall, errno) jobs in parallel, disposable QEMU guests.
+
+Each guest boots from a throwaway qcow2 overlay of a base image that has
+the repository (module built for the guest kernel, server built) at
+--guest-repo and root ssh with the key --ssh-key. TCG is used, so no KVM is
+required; --accel=kvm speeds things up where it is available.
+
+Every job runs `controller.py --launch=MODE --errno=NAME` inside a guest.
+If the guest panics (QEMU exits, -no-reboot), hangs (job timeout) or logs an
+oops on its console, the job is recorded as such, the guest is destroyed
+and a fresh one is booted from a new overlay. Results are appended to
+--results as JSON lines:
+
+    {"syscall": "openat", "errno": "EIO", "guest": 2,
+     "outcome": "ok|error|crash|hang|oops", "secs": 12.3, "tail": "..."}
+
+Usage:
+  ./qemu_runner.py --image=base.qcow2 --ssh-key=id_ed25519 --guests=4 \\
+      [--modes=openat,stat|all] [--errnos=EIO,ENOSPC] [--job-timeout=120]
+"""
+import json
+import os
+import queue
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+BASE_DIR = os.path.dirname(os.path.abspath(__file__))
+ROOT_DIR = os.path.abspath(os.path.join(BASE_DIR, ".."))
+sys.path.insert(0, os.path.join(ROOT_DIR, "controller"))
+
+from catalogue import open_catalogue          # noqa: E402
+from controller import find_opt, find_int_opt  # noqa: E402
+
+OOPS_MARKERS = ("Oops:", "BUG:", "Kernel panic", "general protection fault",
+                "watchdog: BUG: soft lockup", "INFO: task hung")
+SSH_PORT_BASE = 10022
+# ssh may return before a panicking guest (panic=1 -no-reboot) has exited
+CRASH_GRACE_SECS = 5
+
+
+class Guest:
+    """
+    One disposable QEMU guest: overlay disk, serial console log, and an
+    ssh port forwarded from the host.
+    """
+
+    def __init__(self, gid, args, workdir):
+        self.gid = gid
+        self.args = args
+        self.port = SSH_PORT_BASE + gid
+        self.overlay = os.path.join(workdir, f"guest{gid}.qcow2")
+        self.console = os.path.join(workdir, f"guest{gid}.console")
+        self.proc = None
+        self.boots = 0
+
+    def start(self):
+        a = self.args
+        if os.path.exists(self.overlay):
+            os.remove(self.overlay)
+        subprocess.run(["qemu-img", "create", "-q", "-f", "qcow2", "-b",
+                        os.path.abspath(a["image"]), "-F", "qcow2",
+                        self.overlay], check=True)
+        cmd = [a["qemu"], "-machine", f"q35,accel={a['accel']}",
+               "-m", a["mem"], "-smp", "1", "-nographic", "-no-reboot",
+               "-drive", f"file={self.overlay},if=virtio,format=qcow2",
+               "-netdev", f"user,id=n0,hostfwd=tcp:127.0.0.1:{self.port}-:22",
+               "-device", "virtio-net-pci,netdev=n0",
+               "-serial", f"file:{self.console}", "-monitor", "none"]
+        if a["kernel"]:
+            cmd += ["-kernel", a["kernel"], "-append",
+                    f"root=/dev/vda rw console=ttyS0 panic=1 {a['append']}"]
+        self.proc = subprocess.Popen(cmd, stdin=subprocess.DEVNULL,
+                                     stdout=subprocess.DEVNULL,
+                                     stderr=subprocess.DEVNULL)
+        self.boots += 1
+        return self.wait_ssh(a["boot_timeout"])
+
+    def ssh(self, command, timeout):
+        return subprocess.run(
+            ["ssh", "-i", self.args["ssh_key"], "-p", str(self.port),
+             "-o", "StrictHostKeyChecking=no",
+             "-o", "UserKnownHostsFile=/dev/null",
+             "-o", "ConnectTimeout=5", "-o", "LogLevel=ERROR",
+             "root@127.0.0.1", command],
+            capture_output=True, text=True, timeout=timeout)
+
+    def wait_ssh(self, timeout):
+        deadline = time.time() + timeout
+        while time.time() < deadline:
+            if self.proc.poll() is not None:
+                return False
+            try:
+                if self.ssh("true", 10).returncode == 0:
+                    return True
+            except subprocess.TimeoutExpired:
+                pass
+            time.sleep(2)
+        return False
+
+    def console_size(self):
+        try:
+            return os.path.getsize(self.console)
+        except OSError:
+            return 0
+
+    def console_since(self, offset):
+        try:
+            with open(self.console, "rb") as f:
+                f.seek(offset)
+                return f.read().decode(errors="replace")
+        except OSError:
+            return ""
+
+    def stop(self):
+        if self.proc and self.proc.poll() is None:
+            self.proc.kill()
+            self.proc.wait()
+        self.proc = None
+
+
+def run_job(guest, job, args):
+    """
+    Run one (syscall, errno) job; returns the result record.
+    """
+    mode, errno_name = job
+    controller = os.path.join(args["guest_repo"], "Kernel_Space_injections",
+                              "controller", "controller.py")
+    command = (f"timeout {args['job_timeout']} python3 {controller} "
+               f"--launch={mode} --errno={errno_name} {args['extra']}")
+    offset = guest.console_size()
+    t0 = time.time()
+    outcome, tail = "ok", ""
+    try:
+        r = guest.ssh(command, args["job_timeout"] + 30)
+        tail = (r.stdout + r.stderr)[-2000:]
+        if r.returncode != 0:
+            outcome = "error"
+    except subprocess.TimeoutExpired:
+        outcome = "hang"
+
+    if outcome == "error":
+        try:
+            guest.proc.wait(CRASH_GRACE_SECS)
+        except subprocess.TimeoutExpired:
+            pass
+    console = guest.console_since(offset)
+    if guest.proc.poll() is not None:
+        outcome = "crash"
+    elif any(m in console for m in OOPS_MARKERS):
+        outcome = "oops"
+    if outcome in ("crash", "oops", "hang"):
+        tail = console[-4000:] or tail
+
+    return {"syscall": mode, "errno": errno_name, "guest": guest.gid,
+            "outcome": outcome, "secs": round(time.time() - t0, 1),
+            "tail": tail}
+
+
+def worker(guest, jobs, results, lock, args):
+    while True:
+        # Take the job first: no point booting a guest for an empty queue
+        try:
+            job = jobs.get_nowait()
+        except queue.Empty:
+            return
+        if guest.proc is None or guest.proc.poll() is not None:
+            guest.stop()
+            if not guest.start():
+                print(f"[VM] guest{guest.gid}: boot failed, retiring",
+                      file=sys.stderr)
+                guest.stop()
+                jobs.put(job)
+                jobs.task_done()
+                return
+
+        rec = run_job(guest, job, args)
+        with lock:
+            results.write(json.dumps(rec) + "\n")
+            results.flush()
+            os.fsync(results.fileno())
+        print(f"[VM] guest{guest.gid} {job[0]}:{job[1]} -> {rec['outcome']} "
+              f"({rec['secs']}s)")
+
+        # A crashed, hung or tainted guest is never reused
+        if rec["outcome"] in ("crash", "hang", "oops"):
+            guest.stop()
+        jobs.task_done()
+
+
+def build_jobs(modes, errnos, done):
+    cat = open_catalogue()
+    names = [n for n, _ in cat.items()] if modes == "all" else modes.split(",")
+    jobs = []
+    for mode in names:
+        entry = cat.get(mode)
+        if entry is None:
+            print(f"[VM] WARNING: no catalogue entry for {mode}",
+                  file=sys.stderr)
+            continue
+        for ev in entry["error_variants"]:
+            name = ev["errno_name"]
+            if errnos and name not in errnos:
+                continue
+            if (mode, name) not in done:
+                jobs.append((mode, name))
+    return jobs
+
+
+def main():
+    image = find_opt("image")
+    ssh_key = find_opt("ssh-key")
+    if not image or not ssh_key:
+        print(__doc__.strip().split("Usage:")[1], file=sys.stderr)
+        sys.exit(1)
+
+    args = {
+        "image": image,
+        "ssh_key": ssh_key,
+        "qemu": find_opt("qemu", "qemu-system-x86_64"),
+        "accel": find_opt("accel", "tcg"),
+        "mem": find_opt("mem", "1G"),
+        "kernel": find_opt("kernel"),
+        "append": find_opt("append", ""),
+        "guest_repo": find_opt("guest-repo", "/root/Fault-injection-Study"),
+        "boot_timeout": find_int_opt("boot-timeout", 600),
+        "job_timeout": find_int_opt("job-timeout", 120),
+        "extra": find_opt("controller-args", ""),
+    }
+    nguests = find_int_opt("guests", os.cpu_count() or 1)
+    results_path = find_opt("results", "qemu_results.jsonl")
+    errnos = [e for e in (find_opt("errnos") or "").split(",") if e]
+
+    # Jobs already in the results file are not rerun
+    done = set()
+    torn = False
+    if os.path.exists(results_path):
+        with open(results_path, "r") as f:
+            for line in f:
+                torn = not line.endswith("\n")
+                try:
+                    rec = json.loads(line)
+                except ValueError:
+                    continue        # torn write from a host crash
+                done.add((rec["syscall"], rec["errno"]))
+
+    jobs = queue.Queue()
+    todo = build_jobs(find_opt("modes", "all"), errnos, done)
+    for job in todo:
+        jobs.put(job)
+    print(f"[VM] {len(todo)} jobs ({len(done)} already done) "
+          f"on {nguests} guests, accel={args['accel']}")
+
+    workdir = tempfile.mkdtemp(prefix="qemu_runner.")
+    lock = threading.Lock()
+    guests = [Guest(i, args, workdir) for i in range(nguests)]
+    with open(results_path, "a") as results:
+        if torn:
+            results.write("\n")
+        threads = [threading.Thread(target=worker,
+                                    args=(g, jobs, results, lock, args))
+                   for g in guests]
+        try:
+            for t in threads:
+                t.start()
+            for t in threads:
+                t.join()
+        finally:
+            for g in guests:
+                g.stop()
+
+    boots = sum(g.boots for g in guests)
+    print(f"[VM] Done: {len(todo) - jobs.qsize()} jobs run, {boots} boots, "
+          f"results in {results_path}, consoles in {workdir}")
+
+
+if __name__ == "__main__":
+    main()